@@ -3,29 +3,79 @@
 #include <string>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <pthread.h>
 #include "benchmark.hpp"
+#include "memory_profile.hpp"
 #include "cmdline_options.hpp"
 
 
 typedef struct parser_thread_arg_t {
   PCP::partial_csv_t partial_csv;
+  const char * allocator;
+  bool validate_only;
   size_t n_columns;
+  std::vector<size_t> invalid_line_offsets;
 } parser_thread_arg_t;
 
+template <class Row>
+inline void count_columns(PCP::PartialCsvParser & parser, Row & row, size_t * n_columns) {
+  while (parser.get_row(row)) *n_columns += row.size();
+}
+
 void * partial_parse(parser_thread_arg_t * arg) {
   // instantiate parser
   PCP::PartialCsvParser parser(*arg->partial_csv.csv_config, arg->partial_csv.parse_from, arg->partial_csv.parse_to);
 
+  // validate & count-up columns without splitting lines
+  if (arg->validate_only) {
+    const size_t n_lines = parser.validate(arg->invalid_line_offsets);
+    arg->n_columns += n_lines * arg->partial_csv.csv_config->get_n_columns();
+    return NULL;
+  }
+
   // parse & count-up columns
-  std::vector<std::string> row;
-  while (!(row = parser.get_row()).empty()) arg->n_columns += row.size();
+  if (std::strcmp(arg->allocator, "new") == 0) {
+    // new row is allocated for each line
+    std::vector<std::string> row;
+    while (!(row = parser.get_row()).empty()) arg->n_columns += row.size();
+  }
+  else if (std::strcmp(arg->allocator, "reuse") == 0) {
+    std::vector<std::string> row;
+    count_columns(parser, row, &arg->n_columns);
+  }
+#ifdef PCP_HAS_PMR
+  else if (std::strcmp(arg->allocator, "pmr-pool") == 0) {
+    std::pmr::unsynchronized_pool_resource resource;
+    PCP::pmr::row_t row(&resource);
+    count_columns(parser, row, &arg->n_columns);
+  }
+  else if (std::strcmp(arg->allocator, "pmr-monotonic") == 0) {
+    std::pmr::monotonic_buffer_resource resource;
+    PCP::pmr::row_t row(&resource);
+    count_columns(parser, row, &arg->n_columns);
+  }
+#endif
+  else {
+    std::cerr << "Unknown allocator: " << arg->allocator << std::endl;
+    exit(2);
+  }
 
   return NULL;
 }
 
 inline void help_exit(int argc, char * argv[]) {
-  std::cerr << argv[0] << " [-h] -p N_THREADS -c N_EXPECTED_COLUMNS -f FILENAME" << std::endl;
+  std::cerr << argv[0] << " [-h] -p N_THREADS -c N_EXPECTED_COLUMNS -f FILENAME [-a ALLOCATOR] [-d FIELD_TERMINATOR] [-v] [-m CACHE_MODE] [-M] [-j JSON_FILE]" << std::endl;
+  std::cerr << "  ALLOCATOR: new (default), reuse";
+#ifdef PCP_HAS_PMR
+  std::cerr << ", pmr-pool, pmr-monotonic";
+#endif
+  std::cerr << std::endl;
+  std::cerr << "  FIELD_TERMINATOR: bytes to separate columns, e.g. \"||\" (default: \",\")" << std::endl;
+  std::cerr << "  -v: only validate the number of columns of each line" << std::endl;
+  std::cerr << "  CACHE_MODE: none (default, page cache as is), cold (evict FILENAME from page cache), warm (read FILENAME in advance)" << std::endl;
+  std::cerr << "  -M: profile peak RSS and page cache residency while parsing, and allocations if built with BENCH_ALLOC_PROFILE (PartialCsvParser_bench_alloc)" << std::endl;
+  std::cerr << "  -j: append time and hardware counters of each phase to JSON_FILE (JSON Lines)" << std::endl;
   exit(2);
 }
 
@@ -44,9 +94,36 @@ int main(int argc, char * argv[]) {
   const char * filepath = get_cmdline_option(argv, argv + argc, "-f");
   if (!filepath) help_exit(argc, argv);
 
+  const char * allocator = get_cmdline_option(argv, argv + argc, "-a");
+  if (!allocator) allocator = "new";
+
+  const char * field_terminator = get_cmdline_option(argv, argv + argc, "-d");
+  if (!field_terminator) field_terminator = ",";
+  if (field_terminator[0] == '\0') help_exit(argc, argv);
+
+  const bool validate_only = cmdline_option_exists(argv, argv + argc, "-v");
+
+  const char * cache_mode = get_cmdline_option(argv, argv + argc, "-m");
+  if (!cache_mode) cache_mode = "none";
+
+  const bool memory_profile = cmdline_option_exists(argv, argv + argc, "-M");
+
+  const char * json_path = get_cmdline_option(argv, argv + argc, "-j");
+  if (json_path && !bench_open_json(json_path)) {
+    std::cerr << "Cannot open " << json_path << std::endl;
+    return 2;
+  }
+
+  // prepare page cache
+  if (!bench_prepare_page_cache(filepath, cache_mode)) {
+    std::cerr << "Failed to prepare " << cache_mode << " page cache of " << filepath << std::endl;
+    return 2;
+  }
+
   // instantiate CsvConfig
   BENCH_START;
   PCP::CsvConfig csv_config(filepath, false);
+  if (std::strcmp(field_terminator, ",") != 0) csv_config.set_field_terminator(field_terminator);
   BENCH_STOP("mmap(2)+madvise(2) file");
 
   // setup range each thread parse
@@ -54,6 +131,8 @@ int main(int argc, char * argv[]) {
   std::vector<parser_thread_arg_t> parser_thread_args(n_threads);
   for (size_t i = 0; i < n_threads; ++i) {
     parser_thread_arg_t & parser_thread_arg = parser_thread_args[i];
+    parser_thread_arg.allocator = allocator;
+    parser_thread_arg.validate_only = validate_only;
     parser_thread_arg.n_columns = 0;
 
     PCP::partial_csv_t & partial_csv = parser_thread_arg.partial_csv;
@@ -64,17 +143,35 @@ int main(int argc, char * argv[]) {
 
   // create threads
   std::vector<pthread_t> tids(n_threads);
+  ResidencySampler * residency_sampler = NULL;
+  if (memory_profile) {
+    residency_sampler = new ResidencySampler(csv_config.content(), csv_config.filesize());
+    alloc_profiling_start();
+  }
   BENCH_START;
   for (size_t i = 0; i < n_threads; ++i)
       pthread_create(&tids[i], NULL, (void *(*)(void *))partial_parse, &parser_thread_args[i]);
   // join threads
   for (size_t i = 0; i < n_threads; ++i)
       pthread_join(tids[i], NULL);
-  BENCH_STOP("join parsing threads");
+  BENCH_STOP_BYTES("join parsing threads", csv_config.filesize() - csv_config.body_offset());
+  if (memory_profile) {
+    alloc_profiling_stop();
+    residency_sampler->stop();
+    memory_profile_report(validate_only ? "validate" : allocator, *residency_sampler);
+    delete residency_sampler;
+  }
 
   // calculate total number of columns
-  size_t n_total_columns = 0;
-  for (size_t i = 0; i < n_threads; ++i) n_total_columns += parser_thread_args[i].n_columns;
+  size_t n_total_columns = 0, n_invalid_lines = 0;
+  for (size_t i = 0; i < n_threads; ++i) {
+    n_total_columns += parser_thread_args[i].n_columns;
+    n_invalid_lines += parser_thread_args[i].invalid_line_offsets.size();
+  }
+  if (n_invalid_lines > 0) {
+    std::cout << "NG. " << n_invalid_lines << " lines have different number of columns from the first line." << std::endl;
+    return 1;
+  }
 
   // check the answer
   if (n_total_columns == n_expected_columns) {
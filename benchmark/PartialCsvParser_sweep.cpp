@@ -0,0 +1,229 @@
+/**
+ * Sweeps thread counts, chunk sizes and I/O backends of PCP::ParallelCsvParser,
+ * repeating each setting to see variance.
+ */
+
+#include <PartialCsvParser.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include "benchmark.hpp"
+#include "cmdline_options.hpp"
+
+
+typedef struct sweep_result_t {
+  std::string file;
+  std::string backend;
+  std::string cache_mode;
+  size_t n_threads;
+  size_t chunk_size;
+  size_t n_bytes;
+  size_t n_columns;
+  std::vector<double> seconds;  // of each repetition
+  std::vector<double> cycles;  // of each repetition. empty if hardware counters are unavailable.
+  std::vector<double> io_wait_seconds;  // of each repetition
+} sweep_result_t;
+
+inline std::vector<std::string> split_list(const char * list) {
+  return PCP::_split(list, std::strlen(list), ',');
+}
+
+inline std::vector<size_t> split_size_list(const char * list) {
+  std::vector<std::string> strs = split_list(list);
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < strs.size(); ++i) sizes.push_back(std::strtoull(strs[i].c_str(), NULL, 10));
+  return sizes;
+}
+
+/**
+ * Parse whole CSV and return the number of columns.
+ */
+inline size_t parse(const PCP::Memory::CsvConfig & csv_config, size_t n_threads, size_t chunk_size) {
+  PCP::ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  parser.parse([](const std::vector<std::string> &, size_t) {});
+  // every row has the same number of columns, or parse() throws.
+  return parser.get_progress().rows * csv_config.get_n_columns();
+}
+
+/**
+ * Load the file with \p backend and parse it. Loading is included in measured time.
+ */
+inline size_t run(const std::string & file, const std::string & backend, size_t n_threads, size_t chunk_size, /* out */ size_t * n_bytes) {
+  if (backend == "mmap") {
+    PCP::CsvConfig csv_config(file.c_str(), false);
+    *n_bytes = csv_config.filesize();
+    return parse(csv_config, n_threads, chunk_size);
+  }
+  else if (backend == "read") {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1) PERROR_ABORT(("while open " + file).c_str());
+    std::vector<char> buf(PCP::_filesize(fd));
+    for (size_t n_read = 0; n_read < buf.size(); ) {
+      ssize_t ret = read(fd, &buf[n_read], buf.size() - n_read);
+      if (ret <= 0) PERROR_ABORT(("while read " + file).c_str());
+      n_read += ret;
+    }
+    close(fd);
+    PCP::Memory::CsvConfig csv_config(buf.size(), &buf[0], false);
+    *n_bytes = buf.size();
+    return parse(csv_config, n_threads, chunk_size);
+  }
+  std::cerr << "Unknown backend: " << backend << std::endl;
+  exit(2);
+}
+
+inline double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  const size_t n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+inline double mean(const std::vector<double> & values) {
+  double sum = 0;
+  for (size_t i = 0; i < values.size(); ++i) sum += values[i];
+  return sum / values.size();
+}
+
+inline double stddev(const std::vector<double> & values) {
+  if (values.size() < 2) return 0;
+  const double m = mean(values);
+  double sum = 0;
+  for (size_t i = 0; i < values.size(); ++i) sum += (values[i] - m) * (values[i] - m);
+  return std::sqrt(sum / (values.size() - 1));
+}
+
+inline void print_csv(std::ostream & os, const std::vector<sweep_result_t> & results) {
+  os << "file,backend,cache_mode,n_threads,chunk_size,bytes,repetitions,min_sec,median_sec,mean_sec,stddev_sec,median_io_wait_sec,median_bytes_per_sec,median_cycles_per_byte" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const sweep_result_t & r = results[i];
+    os << r.file << "," << r.backend << "," << r.cache_mode << "," << r.n_threads << "," << r.chunk_size << "," << r.n_bytes << ","
+       << r.seconds.size() << "," << *std::min_element(r.seconds.begin(), r.seconds.end()) << ","
+       << median(r.seconds) << "," << mean(r.seconds) << "," << stddev(r.seconds) << "," << median(r.io_wait_seconds) << ","
+       << r.n_bytes / median(r.seconds) << ",";
+    if (!r.cycles.empty()) os << median(r.cycles) / r.n_bytes;
+    os << std::endl;
+  }
+}
+
+inline void print_json(std::ostream & os, const std::vector<sweep_result_t> & results) {
+  os << "[" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const sweep_result_t & r = results[i];
+    os << "  {\"file\":\"" << r.file << "\",\"backend\":\"" << r.backend << "\",\"cache_mode\":\"" << r.cache_mode << "\",\"n_threads\":" << r.n_threads
+       << ",\"chunk_size\":" << r.chunk_size << ",\"bytes\":" << r.n_bytes << ",\"seconds\":[";
+    for (size_t j = 0; j < r.seconds.size(); ++j) os << (j == 0 ? "" : ",") << r.seconds[j];
+    os << "],\"cycles\":";
+    if (r.cycles.empty()) os << "null";
+    else {
+      os << "[";
+      for (size_t j = 0; j < r.cycles.size(); ++j) os << (j == 0 ? "" : ",") << r.cycles[j];
+      os << "]";
+    }
+    os << ",\"io_wait_seconds\":[";
+    for (size_t j = 0; j < r.io_wait_seconds.size(); ++j) os << (j == 0 ? "" : ",") << r.io_wait_seconds[j];
+    os << "]";
+    os << ",\"median_sec\":" << median(r.seconds) << ",\"stddev_sec\":" << stddev(r.seconds)
+       << ",\"median_bytes_per_sec\":" << r.n_bytes / median(r.seconds) << "}"
+       << (i + 1 == results.size() ? "" : ",") << std::endl;
+  }
+  os << "]" << std::endl;
+}
+
+inline void help_exit(int argc, char * argv[]) {
+  std::cerr << argv[0] << " [-h] -f FILENAMES [-p N_THREADS_LIST] [-s CHUNK_SIZES] [-b BACKENDS] [-r REPETITIONS] [-m CACHE_MODE] [-F FORMAT]" << std::endl;
+  std::cerr << "  FILENAMES: comma-separated CSV files without header" << std::endl;
+  std::cerr << "  N_THREADS_LIST: comma-separated thread counts, 0 for ParallelCsvParser::AUTO (default: 1 to the number of CPUs)" << std::endl;
+  std::cerr << "  CHUNK_SIZES: comma-separated chunk sizes in bytes, 0 for ParallelCsvParser::AUTO (default: 262144,1048576,4194304,16777216)" << std::endl;
+  std::cerr << "  BACKENDS: comma-separated from mmap, read (default: mmap,read)" << std::endl;
+  std::cerr << "  REPETITIONS: runs per setting (default: 5)" << std::endl;
+  std::cerr << "  CACHE_MODE: none (default), cold (evict files from page cache before each run), warm (read files before each run)" << std::endl;
+  std::cerr << "  FORMAT: csv (default), json" << std::endl;
+  exit(2);
+}
+
+int main(int argc, char * argv[]) {
+  // command line options
+  if (cmdline_option_exists(argv, argv + argc, "-h")) help_exit(argc, argv);
+
+  const char * files_str = get_cmdline_option(argv, argv + argc, "-f");
+  if (!files_str) help_exit(argc, argv);
+  const std::vector<std::string> files = split_list(files_str);
+
+  std::vector<size_t> n_threads_list;
+  const char * n_threads_str = get_cmdline_option(argv, argv + argc, "-p");
+  if (n_threads_str) n_threads_list = split_size_list(n_threads_str);
+  else for (size_t i = 1; i <= std::max(1u, std::thread::hardware_concurrency()); ++i) n_threads_list.push_back(i);
+
+  const char * chunk_sizes_str = get_cmdline_option(argv, argv + argc, "-s");
+  const std::vector<size_t> chunk_sizes = split_size_list(chunk_sizes_str ? chunk_sizes_str : "262144,1048576,4194304,16777216");
+
+  const char * backends_str = get_cmdline_option(argv, argv + argc, "-b");
+  const std::vector<std::string> backends = split_list(backends_str ? backends_str : "mmap,read");
+
+  const char * repetitions_str = get_cmdline_option(argv, argv + argc, "-r");
+  const size_t repetitions = repetitions_str ? std::atoi(repetitions_str) : 5;
+  if (repetitions == 0) help_exit(argc, argv);
+
+  const char * cache_mode_str = get_cmdline_option(argv, argv + argc, "-m");
+  const std::string cache_mode = cache_mode_str ? cache_mode_str : "none";
+
+  const char * format_str = get_cmdline_option(argv, argv + argc, "-F");
+  const std::string format = format_str ? format_str : "csv";
+  if (format != "csv" && format != "json") help_exit(argc, argv);
+
+  // sweep
+  std::vector<sweep_result_t> results;
+  size_t n_expected_columns = 0;
+  for (size_t i_file = 0; i_file < files.size(); ++i_file) {
+    for (size_t i_backend = 0; i_backend < backends.size(); ++i_backend) {
+      for (size_t i_threads = 0; i_threads < n_threads_list.size(); ++i_threads) {
+        for (size_t i_chunk = 0; i_chunk < chunk_sizes.size(); ++i_chunk) {
+          sweep_result_t result;
+          result.file = files[i_file];
+          result.backend = backends[i_backend];
+          result.cache_mode = cache_mode;
+          result.n_threads = n_threads_list[i_threads];
+          result.chunk_size = chunk_sizes[i_chunk];
+
+          for (size_t i = 0; i < repetitions; ++i) {
+            if (!bench_prepare_page_cache(result.file.c_str(), cache_mode)) {
+              std::cerr << "Failed to prepare " << cache_mode << " page cache of " << result.file << std::endl;
+              return 2;
+            }
+            const bench_usage_t usage_start = bench_get_usage();
+            _perf_counters.start();
+            const double t_start = gettimeofday_sec();
+            result.n_columns = run(result.file, result.backend, result.n_threads, result.chunk_size, &result.n_bytes);
+            result.seconds.push_back(gettimeofday_sec() - t_start);
+            _perf_counters.stop();
+            result.io_wait_seconds.push_back(bench_get_usage().blkio_delay_sec - usage_start.blkio_delay_sec);
+            if (_perf_counters.is_available(PerfCounters::CYCLES))
+              result.cycles.push_back(_perf_counters.get(PerfCounters::CYCLES));
+          }
+
+          // all settings must agree on the answer
+          if (i_backend == 0 && i_threads == 0 && i_chunk == 0) n_expected_columns = result.n_columns;
+          else if (result.n_columns != n_expected_columns) {
+            std::cerr << "NG. Parsed " << result.n_columns << " columns from " << result.file << " (" << result.backend
+                      << ", " << result.n_threads << " threads, chunk " << result.chunk_size << "), while "
+                      << n_expected_columns << " columns are expected." << std::endl;
+            return 1;
+          }
+
+          std::cerr << result.file << " " << result.backend << " " << result.n_threads << " threads, chunk " << result.chunk_size
+                    << ": " << median(result.seconds) << " seconds (median of " << repetitions << ")" << std::endl;
+          results.push_back(result);
+        }
+      }
+    }
+  }
+
+  if (format == "csv") print_csv(std::cout, results);
+  else print_json(std::cout, results);
+  return 0;
+}
@@ -2,8 +2,24 @@
 #define BENCHMARK_BENCHMARK_HPP_
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
 #include <ctime>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 inline double gettimeofday_sec() {
   struct timeval tv;
@@ -11,14 +27,248 @@ inline double gettimeofday_sec() {
   return tv.tv_sec + (double)tv.tv_usec*1e-6;
 }
 
+/**
+ * Hardware performance counters of this process (including threads created after start()) by perf_event_open(2).
+ * Counters not permitted (e.g. by /proc/sys/kernel/perf_event_paranoid) or not supported are just unavailable.
+ */
+class PerfCounters {
+public:
+  enum counter_t { CYCLES = 0, INSTRUCTIONS, BRANCH_MISSES, LLC_MISSES, N_COUNTERS };
+
+  PerfCounters() : user_only(false) {
+    for (int i = 0; i < N_COUNTERS; ++i) {
+      fds[i] = -1;
+      values[i] = 0;
+    }
+#ifdef __linux__
+    static const uint64_t configs[N_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+    };
+    for (int i = 0; i < N_COUNTERS; ++i) {
+      fds[i] = open_counter(configs[i], user_only);
+      if (fds[i] < 0 && (errno == EACCES || errno == EPERM) && !user_only) {
+        // kernel events are not permitted for unprivileged users. count user space only.
+        user_only = true;
+        fds[i] = open_counter(configs[i], user_only);
+      }
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < N_COUNTERS; ++i) if (fds[i] >= 0) close(fds[i]);
+#endif
+  }
+
+  inline void start() {
+#ifdef __linux__
+    for (int i = 0; i < N_COUNTERS; ++i) {
+      if (fds[i] < 0) continue;
+      ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  inline void stop() {
+#ifdef __linux__
+    for (int i = 0; i < N_COUNTERS; ++i) {
+      if (fds[i] < 0) continue;
+      ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      // value, time enabled, time running. scale if counters were multiplexed.
+      uint64_t buf[3];
+      if (read(fds[i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) {
+        values[i] = 0;
+        continue;
+      }
+      values[i] = buf[2] < buf[1] ? (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+    }
+#endif
+  }
+
+  inline bool is_available(counter_t counter) const { return fds[counter] >= 0; }
+  inline uint64_t get(counter_t counter) const { return values[counter]; }
+
+  /**
+   * True if kernel-space events are excluded.
+   */
+  inline bool is_user_only() const { return user_only; }
+
+  static inline const char * name(counter_t counter) {
+    static const char * names[N_COUNTERS] = { "cycles", "instructions", "branch_misses", "llc_misses" };
+    return names[counter];
+  }
+
+private:
+  int fds[N_COUNTERS];
+  uint64_t values[N_COUNTERS];
+  bool user_only;
+
+#ifdef __linux__
+  static inline int open_counter(uint64_t config, bool exclude_kernel) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;  // count worker threads as well
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+#endif
+};
+
+/**
+ * Resource usage of this process, to tell CPU time from waiting for I/O.
+ */
+typedef struct bench_usage_t {
+  double cpu_sec;  ///< User + system time of all threads.
+  double blkio_delay_sec;  ///< Time waiting for block I/O. Always 0 if delay accounting of kernel is disabled.
+  long major_faults;  ///< Page faults which needed I/O.
+  long inblock;  ///< Blocks read from file systems.
+} bench_usage_t;
+
+inline bench_usage_t bench_get_usage() {
+  bench_usage_t usage = { 0, 0, 0, 0 };
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+    usage.cpu_sec = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+    usage.major_faults = ru.ru_majflt;
+    usage.inblock = ru.ru_inblock;
+  }
+#ifdef __linux__
+  // delayacct_blkio_ticks is the 42nd field of /proc/self/stat. fields start from 3rd after comm in parentheses.
+  std::ifstream stat("/proc/self/stat");
+  std::string line;
+  if (std::getline(stat, line) && line.rfind(')') != std::string::npos) {
+    std::istringstream fields(line.substr(line.rfind(')') + 1));
+    std::string field;
+    for (int i = 3; i <= 42 && fields >> field; ++i) {
+      if (i == 42) usage.blkio_delay_sec = std::strtod(field.c_str(), NULL) / sysconf(_SC_CLK_TCK);
+    }
+  }
+#endif
+  return usage;
+}
+
+/**
+ * Evict pages of \p path from page cache, to measure with cold cache.
+ * Pages mapped by other processes are not evicted.
+ */
+inline bool bench_evict_page_cache(const char * path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) return false;
+  bool ok = true;
+#ifdef POSIX_FADV_DONTNEED
+  ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+#else
+  ok = false;
+#endif
+  close(fd);
+  return ok;
+}
+
+/**
+ * Read whole \p path once to load it to page cache, to measure with warm cache.
+ */
+inline bool bench_warm_page_cache(const char * path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) return false;
+  std::vector<char> buf(1 << 20);
+  ssize_t ret;
+  while ((ret = read(fd, &buf[0], buf.size())) > 0);
+  close(fd);
+  return ret == 0;
+}
+
+/**
+ * Prepare page cache of \p path by \p cache_mode: "cold", "warm" or "none" (leave as is).
+ */
+inline bool bench_prepare_page_cache(const char * path, const std::string & cache_mode) {
+  if (cache_mode == "cold") return bench_evict_page_cache(path);
+  if (cache_mode == "warm") return bench_warm_page_cache(path);
+  return cache_mode == "none";
+}
+
 double _t_start, _t_stop;
+bench_usage_t _usage_start, _usage_stop;
+PerfCounters _perf_counters;
+std::ofstream _bench_json;
+
+/**
+ * Write a JSON object per BENCH_STOP to \p path (JSON Lines) in addition to human-readable output to stderr.
+ */
+inline bool bench_open_json(const char * path) {
+  _bench_json.open(path, std::ios::app);
+  return _bench_json.good();
+}
+
+/**
+ * Print resource usage and hardware counters of the last phase, and write them to JSON output if opened.
+ */
+inline void bench_report(const char * file, int line, const char * msg, double elapsed_sec, size_t n_bytes) {
+  const PerfCounters & pc = _perf_counters;
+  const double cpu_sec = _usage_stop.cpu_sec - _usage_start.cpu_sec;
+  const double blkio_delay_sec = _usage_stop.blkio_delay_sec - _usage_start.blkio_delay_sec;
+  const long major_faults = _usage_stop.major_faults - _usage_start.major_faults;
+  const long inblock = _usage_stop.inblock - _usage_start.inblock;
+  const bool has_cycles = pc.is_available(PerfCounters::CYCLES), has_instructions = pc.is_available(PerfCounters::INSTRUCTIONS);
+
+  std::cerr << "    " << cpu_sec << " CPU seconds, " << blkio_delay_sec << " I/O wait seconds, "
+            << major_faults << " major faults, " << inblock << " blocks read" << std::endl;
+  std::cerr << "    ";
+  if (n_bytes > 0) std::cerr << n_bytes / elapsed_sec / 1e6 << " MB/sec, ";
+  if (has_cycles && n_bytes > 0) std::cerr << (double)pc.get(PerfCounters::CYCLES) / n_bytes << " cycles/byte, ";
+  if (has_cycles && has_instructions) std::cerr << (double)pc.get(PerfCounters::INSTRUCTIONS) / pc.get(PerfCounters::CYCLES) << " IPC, ";
+  for (int i = PerfCounters::BRANCH_MISSES; i < PerfCounters::N_COUNTERS; ++i) {
+    if (pc.is_available((PerfCounters::counter_t)i))
+      std::cerr << pc.get((PerfCounters::counter_t)i) << " " << PerfCounters::name((PerfCounters::counter_t)i) << ", ";
+  }
+  if (!has_cycles) std::cerr << "(hardware counters unavailable)";
+  else if (pc.is_user_only()) std::cerr << "(user space only)";
+  std::cerr << std::endl;
+
+  if (!_bench_json.is_open()) return;
+  _bench_json << "{\"file\":\"" << file << "\",\"line\":" << line << ",\"phase\":\"";
+  for (const char * c = msg; *c; ++c) {
+    if (*c == '"' || *c == '\\') _bench_json << '\\';
+    _bench_json << *c;
+  }
+  _bench_json << "\",\"seconds\":" << elapsed_sec << ",\"bytes\":" << n_bytes;
+  if (n_bytes > 0) _bench_json << ",\"bytes_per_sec\":" << n_bytes / elapsed_sec;
+  _bench_json << ",\"cpu_sec\":" << cpu_sec << ",\"io_wait_sec\":" << blkio_delay_sec
+              << ",\"major_faults\":" << major_faults << ",\"blocks_read\":" << inblock;
+  for (int i = 0; i < PerfCounters::N_COUNTERS; ++i) {
+    _bench_json << ",\"" << PerfCounters::name((PerfCounters::counter_t)i) << "\":";
+    if (pc.is_available((PerfCounters::counter_t)i)) _bench_json << pc.get((PerfCounters::counter_t)i);
+    else _bench_json << "null";
+  }
+  if (has_cycles && n_bytes > 0) _bench_json << ",\"cycles_per_byte\":" << (double)pc.get(PerfCounters::CYCLES) / n_bytes;
+  if (has_cycles && has_instructions) _bench_json << ",\"ipc\":" << (double)pc.get(PerfCounters::INSTRUCTIONS) / pc.get(PerfCounters::CYCLES);
+  _bench_json << ",\"user_only\":" << (pc.is_user_only() ? "true" : "false") << "}" << std::endl;
+}
 
 #define BENCH_START \
+  _usage_start = bench_get_usage(); \
+  _perf_counters.start(); \
   _t_start = gettimeofday_sec();
 
 #define BENCH_STOP(msg) \
+  BENCH_STOP_BYTES(msg, 0)
+
+/**
+ * Same as BENCH_STOP but also reports throughput and cycles per byte of \p n_bytes processed.
+ */
+#define BENCH_STOP_BYTES(msg, n_bytes) \
   _t_stop = gettimeofday_sec(); \
-  std::cerr << __FILE__ << ":" << __LINE__ << " - " << _t_stop - _t_start << " seconds - " << msg << std::endl;
+  _perf_counters.stop(); \
+  _usage_stop = bench_get_usage(); \
+  std::cerr << __FILE__ << ":" << __LINE__ << " - " << _t_stop - _t_start << " seconds - " << msg << std::endl; \
+  bench_report(__FILE__, __LINE__, msg, _t_stop - _t_start, n_bytes);
 
 
 #endif /* BENCHMARK_BENCHMARK_HPP_ */
@@ -0,0 +1,330 @@
+/**
+ * Runs identical workloads with PartialCsvParser and other CSV parsers on the same file,
+ * and prints a side-by-side report.
+ *
+ * Other parsers are optional. Each is compiled in only when its local copy is found by CMake:
+ * - HAVE_CSV_PARSER_CPLUSPLUS: csv-parser-cplusplus (https://code.google.com/p/csv-parser-cplusplus)
+ * - HAVE_FAST_CPP_CSV_PARSER: fast-cpp-csv-parser (https://github.com/ben-strasser/fast-cpp-csv-parser)
+ */
+
+#include <PartialCsvParser.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <stdint.h>
+#include "benchmark.hpp"
+#include "cmdline_options.hpp"
+#ifdef HAVE_CSV_PARSER_CPLUSPLUS
+#include <csv_parser/csv_parser.hpp>
+#endif
+#ifdef HAVE_FAST_CPP_CSV_PARSER
+#include <csv.h>
+#endif
+
+
+/**
+ * Workload applied to every row. All parsers must give the same result.
+ */
+class Workload {
+public:
+  enum kind_t { COUNT_FIELDS, SUM_COLUMN, PROJECT_COLUMNS };
+
+  Workload(kind_t kind, const std::vector<size_t> & columns) : kind(kind), columns(columns), result(0) {}
+
+  /**
+   * Consume a row given as a sequence of strings (e.g. std::vector<std::string>).
+   */
+  template <class Row>
+  inline void consume_row(const Row & row) {
+    switch (kind) {
+    case COUNT_FIELDS:
+      result += row.size();
+      break;
+    case SUM_COLUMN:
+      if (columns[0] < row.size()) result += parse_uint(row[columns[0]].data(), row[columns[0]].size());
+      break;
+    case PROJECT_COLUMNS:
+      for (size_t i = 0; i < columns.size(); ++i) {
+        if (columns[i] < row.size()) projected.append(row[columns[i]].data(), row[columns[i]].size());
+        projected.push_back(',');
+      }
+      result += projected.size();
+      projected.clear();
+      break;
+    }
+  }
+
+  /**
+   * Consume a row given as an array of null-terminated strings.
+   */
+  inline void consume_row(char * const * fields, size_t n_fields) {
+    switch (kind) {
+    case COUNT_FIELDS:
+      result += n_fields;
+      break;
+    case SUM_COLUMN:
+      if (columns[0] < n_fields) result += parse_uint(fields[columns[0]], std::strlen(fields[columns[0]]));
+      break;
+    case PROJECT_COLUMNS:
+      for (size_t i = 0; i < columns.size(); ++i) {
+        if (columns[i] < n_fields) projected.append(fields[columns[i]]);
+        projected.push_back(',');
+      }
+      result += projected.size();
+      projected.clear();
+      break;
+    }
+  }
+
+  inline uint64_t get_result() const { return result; }
+
+  /**
+   * Add up result of another workload (e.g. of another thread).
+   */
+  inline void merge(const Workload & other) { result += other.result; }
+
+  static inline const char * name(kind_t kind) {
+    static const char * names[] = { "count", "sum", "project" };
+    return names[kind];
+  }
+
+private:
+  kind_t kind;
+  std::vector<size_t> columns;
+  uint64_t result;
+  std::string projected;  // buffer for a projected row
+
+  /**
+   * Same conversion for all parsers, to measure parsers rather than number conversions.
+   */
+  static inline uint64_t parse_uint(const char * str, size_t len) {
+    uint64_t n = 0;
+    for (size_t i = 0; i < len && '0' <= str[i] && str[i] <= '9'; ++i) n = n * 10 + (str[i] - '0');
+    return n;
+  }
+};
+
+
+/**
+ * Baseline: std::getline() and splitting by std::string::find().
+ */
+inline void run_getline(const char * filepath, Workload & workload) {
+  std::ifstream ifs(filepath);
+  std::string line;
+  std::vector<std::string> row;
+  while (std::getline(ifs, line)) {
+    row.clear();
+    size_t begin = 0, end;
+    while ((end = line.find(',', begin)) != std::string::npos) {
+      row.push_back(line.substr(begin, end - begin));
+      begin = end + 1;
+    }
+    row.push_back(line.substr(begin));
+    workload.consume_row(row);
+  }
+}
+
+inline void run_PartialCsvParser(const char * filepath, Workload & workload) {
+  PCP::CsvConfig csv_config(filepath, false);
+  PCP::PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+  while (parser.get_row(row)) workload.consume_row(row);
+}
+
+/**
+ * PartialCsvParser with \p n_threads threads, each parses its own range with its own workload.
+ */
+inline void run_PartialCsvParser_threads(const char * filepath, size_t n_threads, Workload & workload) {
+  PCP::CsvConfig csv_config(filepath, false);
+  const size_t size_per_thread = (csv_config.filesize() - csv_config.body_offset()) / n_threads;
+  std::vector<Workload> workloads(n_threads, workload);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < n_threads; ++i) {
+    threads.push_back(std::thread([&, i]() {
+      const size_t parse_from = csv_config.body_offset() + i * size_per_thread;
+      const size_t parse_to = i == n_threads - 1 ? csv_config.filesize() - 1 : parse_from + size_per_thread - 1;
+      PCP::PartialCsvParser parser(csv_config, parse_from, parse_to);
+      std::vector<std::string> row;
+      while (parser.get_row(row)) workloads[i].consume_row(row);
+    }));
+  }
+  for (size_t i = 0; i < n_threads; ++i) {
+    threads[i].join();
+    workload.merge(workloads[i]);
+  }
+}
+
+#ifdef HAVE_CSV_PARSER_CPLUSPLUS
+inline void run_csv_parser_cplusplus(const char * filepath, Workload & workload) {
+  csv_parser file_parser;
+  file_parser.init(filepath);
+  file_parser.set_enclosed_char('"', ENCLOSURE_NONE);  // Same as PartialCsvParser
+  file_parser.set_field_term_char(',');
+  file_parser.set_line_term_char('\n');
+  while (file_parser.has_more_rows()) workload.consume_row(file_parser.get_row());
+}
+#endif
+
+#ifdef HAVE_FAST_CPP_CSV_PARSER
+/**
+ * fast-cpp-csv-parser needs the number of columns at compile time. Benchmark data has 5 columns,
+ * and files with other number of columns are skipped.
+ */
+enum { FAST_CPP_CSV_PARSER_N_COLUMNS = 5 };
+
+inline void run_fast_cpp_csv_parser(const char * filepath, Workload & workload) {
+  io::CSVReader<FAST_CPP_CSV_PARSER_N_COLUMNS, io::trim_chars<>, io::no_quote_escape<','> > reader(filepath);
+  reader.set_header("c0", "c1", "c2", "c3", "c4");
+  char * fields[FAST_CPP_CSV_PARSER_N_COLUMNS];
+  while (reader.read_row(fields[0], fields[1], fields[2], fields[3], fields[4])) workload.consume_row(fields, FAST_CPP_CSV_PARSER_N_COLUMNS);
+}
+#endif
+
+
+typedef struct compare_result_t {
+  std::string parser;
+  std::vector<double> seconds;
+  uint64_t result;
+} compare_result_t;
+
+inline double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  const size_t n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+inline void help_exit(int argc, char * argv[]) {
+  std::cerr << argv[0] << " [-h] -f FILENAME [-w WORKLOAD] [-k COLUMNS] [-p N_THREADS] [-r REPETITIONS] [-m CACHE_MODE] [-F FORMAT]" << std::endl;
+  std::cerr << "  FILENAME: CSV file without header, without enclosure characters" << std::endl;
+  std::cerr << "  WORKLOAD: count (default, count fields), sum (sum of a numeric column), project (copy columns out)" << std::endl;
+  std::cerr << "  COLUMNS: comma-separated 0-origin column indexes for sum (first one) and project (default: 0)" << std::endl;
+  std::cerr << "  N_THREADS: threads of multi-threaded PartialCsvParser run (default: the number of CPUs)" << std::endl;
+  std::cerr << "  REPETITIONS: runs per parser (default: 3)" << std::endl;
+  std::cerr << "  CACHE_MODE: warm (default), cold, none" << std::endl;
+  std::cerr << "  FORMAT: markdown (default), csv" << std::endl;
+  std::cerr << "Parsers compiled in: getline, PartialCsvParser";
+#ifdef HAVE_CSV_PARSER_CPLUSPLUS
+  std::cerr << ", csv-parser-cplusplus";
+#endif
+#ifdef HAVE_FAST_CPP_CSV_PARSER
+  std::cerr << ", fast-cpp-csv-parser";
+#endif
+  std::cerr << std::endl;
+  exit(2);
+}
+
+int main(int argc, char * argv[]) {
+  // command line options
+  if (cmdline_option_exists(argv, argv + argc, "-h")) help_exit(argc, argv);
+
+  const char * filepath = get_cmdline_option(argv, argv + argc, "-f");
+  if (!filepath) help_exit(argc, argv);
+
+  const char * workload_str = get_cmdline_option(argv, argv + argc, "-w");
+  Workload::kind_t kind = Workload::COUNT_FIELDS;
+  if (workload_str) {
+    if (std::strcmp(workload_str, "count") == 0) kind = Workload::COUNT_FIELDS;
+    else if (std::strcmp(workload_str, "sum") == 0) kind = Workload::SUM_COLUMN;
+    else if (std::strcmp(workload_str, "project") == 0) kind = Workload::PROJECT_COLUMNS;
+    else help_exit(argc, argv);
+  }
+
+  const char * columns_str = get_cmdline_option(argv, argv + argc, "-k");
+  std::vector<size_t> columns;
+  const std::vector<std::string> column_strs = PCP::_split(columns_str ? columns_str : "0", std::strlen(columns_str ? columns_str : "0"), ',');
+  for (size_t i = 0; i < column_strs.size(); ++i) columns.push_back(std::atoi(column_strs[i].c_str()));
+
+  const char * n_threads_str = get_cmdline_option(argv, argv + argc, "-p");
+  const size_t n_threads = n_threads_str ? std::atoi(n_threads_str) : std::max(1u, std::thread::hardware_concurrency());
+
+  const char * repetitions_str = get_cmdline_option(argv, argv + argc, "-r");
+  const size_t repetitions = repetitions_str ? std::atoi(repetitions_str) : 3;
+  if (n_threads == 0 || repetitions == 0) help_exit(argc, argv);
+
+  const char * cache_mode_str = get_cmdline_option(argv, argv + argc, "-m");
+  const std::string cache_mode = cache_mode_str ? cache_mode_str : "warm";
+
+  const char * format_str = get_cmdline_option(argv, argv + argc, "-F");
+  const std::string format = format_str ? format_str : "markdown";
+  if (format != "markdown" && format != "csv") help_exit(argc, argv);
+
+  // parsers to compare
+  std::vector<std::string> parsers;
+  parsers.push_back("getline");
+  parsers.push_back("PartialCsvParser");
+  parsers.push_back("PartialCsvParser (" + std::to_string(n_threads) + " threads)");
+#ifdef HAVE_CSV_PARSER_CPLUSPLUS
+  parsers.push_back("csv-parser-cplusplus");
+#endif
+#ifdef HAVE_FAST_CPP_CSV_PARSER
+  const size_t n_columns = PCP::CsvConfig(filepath, false).get_n_columns();
+  if (n_columns == FAST_CPP_CSV_PARSER_N_COLUMNS) parsers.push_back("fast-cpp-csv-parser");
+  else std::cerr << "fast-cpp-csv-parser: skipped, since it is built for " << int(FAST_CPP_CSV_PARSER_N_COLUMNS)
+                 << " columns while " << filepath << " has " << n_columns << " columns" << std::endl;
+#endif
+
+  // run
+  std::vector<compare_result_t> results;
+  for (size_t i_parser = 0; i_parser < parsers.size(); ++i_parser) {
+    compare_result_t result;
+    result.parser = parsers[i_parser];
+    for (size_t i = 0; i < repetitions; ++i) {
+      if (!bench_prepare_page_cache(filepath, cache_mode)) {
+        std::cerr << "Failed to prepare " << cache_mode << " page cache of " << filepath << std::endl;
+        return 2;
+      }
+      Workload workload(kind, columns);
+      const double t_start = gettimeofday_sec();
+      if (i_parser == 0) run_getline(filepath, workload);
+      else if (i_parser == 1) run_PartialCsvParser(filepath, workload);
+      else if (i_parser == 2) run_PartialCsvParser_threads(filepath, n_threads, workload);
+#ifdef HAVE_CSV_PARSER_CPLUSPLUS
+      else if (result.parser == "csv-parser-cplusplus") run_csv_parser_cplusplus(filepath, workload);
+#endif
+#ifdef HAVE_FAST_CPP_CSV_PARSER
+      else if (result.parser == "fast-cpp-csv-parser") run_fast_cpp_csv_parser(filepath, workload);
+#endif
+      result.seconds.push_back(gettimeofday_sec() - t_start);
+      result.result = workload.get_result();
+    }
+    std::cerr << result.parser << ": " << median(result.seconds) << " seconds (median of " << repetitions << ")" << std::endl;
+    results.push_back(result);
+  }
+
+  // report
+  int fd = open(filepath, O_RDONLY);
+  const size_t filesize = fd == -1 ? 0 : PCP::_filesize(fd);
+  if (fd != -1) close(fd);
+  const double baseline_sec = median(results[0].seconds);
+  bool agreed = true;
+
+  if (format == "markdown") {
+    std::cout << "Workload: " << Workload::name(kind) << ", file: " << filepath << " (" << filesize << " bytes), cache: " << cache_mode << std::endl
+              << std::endl
+              << "| Parser | Median seconds | MB/sec | Speedup over getline | Result |" << std::endl
+              << "|--------|---------------:|-------:|---------------------:|-------:|" << std::endl;
+  }
+  else {
+    std::cout << "workload,file,cache_mode,parser,repetitions,median_sec,bytes_per_sec,speedup,result" << std::endl;
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    const compare_result_t & r = results[i];
+    const double sec = median(r.seconds);
+    if (format == "markdown")
+      std::cout << "| " << r.parser << " | " << sec << " | " << filesize / sec / 1e6 << " | " << baseline_sec / sec << " | " << r.result << " |" << std::endl;
+    else
+      std::cout << Workload::name(kind) << "," << filepath << "," << cache_mode << "," << r.parser << "," << r.seconds.size() << ","
+                << sec << "," << filesize / sec << "," << baseline_sec / sec << "," << r.result << std::endl;
+    if (r.result != results[0].result) agreed = false;
+  }
+
+  if (!agreed) {
+    std::cerr << "NG. Parsers gave different results." << std::endl;
+    return 1;
+  }
+  return 0;
+}
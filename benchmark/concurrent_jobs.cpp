@@ -0,0 +1,135 @@
+/**
+ * Runs N concurrent parse jobs of PCP::ParallelCsvParser, each starting its own threads
+ * or sharing PCP::Executor, and reports total throughput and latency of jobs.
+ * Optionally, background jobs throttled by PCP::ResourceGovernor keep parsing meanwhile as synthetic contention.
+ */
+
+#include <PartialCsvParser.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "benchmark.hpp"
+#include "cmdline_options.hpp"
+
+
+/**
+ * Start \p n_jobs parses of \p csv_config at once and wait for all.
+ * \p n_background_jobs parse \p csv_config repeatedly under \p governor until the jobs finish.
+ * @param executor NULL to start threads for each job.
+ * @return Sum of columns parsed by all jobs, excluding background jobs.
+ */
+inline size_t run_jobs(const PCP::CsvConfig & csv_config, size_t n_jobs, size_t n_threads, PCP::Executor * executor,
+                       size_t n_background_jobs, PCP::ResourceGovernor * governor,
+                       /* out */ PCP::LatencyHistogram * job_latencies, /* out */ double * elapsed_sec)
+{
+  PCP::CancellationToken background_token;
+  std::vector<std::thread> background;
+  for (size_t i = 0; i < n_background_jobs; ++i) {
+    background.push_back(std::thread([&]() {
+      try {
+        while (true) {
+          PCP::ParallelCsvParser parser(csv_config, n_threads);
+          if (executor) parser.set_executor(executor, -1);
+          parser.set_resource_governor(governor);
+          parser.set_cancellation_token(&background_token);
+          parser.parse([](const std::vector<std::string> &, size_t) {});
+        }
+      }
+      catch (const PCP::PCPCancelledError &) {}
+    }));
+  }
+
+  std::vector<size_t> n_columns(n_jobs, 0);
+  std::vector<std::chrono::steady_clock::duration> latencies(n_jobs);
+  std::vector<std::thread> clients;
+  const double t_start = gettimeofday_sec();
+  for (size_t i_job = 0; i_job < n_jobs; ++i_job) {
+    clients.push_back(std::thread([&, i_job]() {
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      PCP::ParallelCsvParser parser(csv_config, n_threads);
+      if (executor) parser.set_executor(executor);
+      parser.parse([](const std::vector<std::string> &, size_t) {});
+      n_columns[i_job] = parser.get_progress().rows * csv_config.get_n_columns();
+      latencies[i_job] = std::chrono::steady_clock::now() - start;
+    }));
+  }
+  for (size_t i = 0; i < clients.size(); ++i) clients[i].join();
+  *elapsed_sec = gettimeofday_sec() - t_start;
+  background_token.cancel();
+  for (size_t i = 0; i < background.size(); ++i) background[i].join();
+
+  size_t sum = 0;
+  for (size_t i = 0; i < n_jobs; ++i) {
+    sum += n_columns[i];
+    job_latencies->record(latencies[i]);
+  }
+  return sum;
+}
+
+inline void help_exit(int argc, char * argv[]) {
+  std::cerr << argv[0] << " [-h] -f FILENAME [-n N_JOBS] [-p N_THREADS] [-w N_WORKERS] [-B N_BACKGROUND_JOBS [-l BYTES_PER_SEC] [-W MAX_WORKERS]]" << std::endl;
+  std::cerr << "  FILENAME: CSV file without header, parsed by every job" << std::endl;
+  std::cerr << "  N_JOBS: number of concurrent jobs (default: 8)" << std::endl;
+  std::cerr << "  N_THREADS: threads (or concurrent tasks) of each job (default: ParallelCsvParser::AUTO)" << std::endl;
+  std::cerr << "  N_WORKERS: workers of shared executor (default: ParallelCsvParser::available_cpus())" << std::endl;
+  std::cerr << "  N_BACKGROUND_JOBS: jobs parsing repeatedly while the jobs run, with lower priority in executor (default: 0)" << std::endl;
+  std::cerr << "  BYTES_PER_SEC: read budget shared by background jobs (default: unlimited)" << std::endl;
+  std::cerr << "  MAX_WORKERS: max workers of each background job (default: unlimited)" << std::endl;
+  exit(2);
+}
+
+int main(int argc, char * argv[]) {
+  // command line options
+  if (cmdline_option_exists(argv, argv + argc, "-h")) help_exit(argc, argv);
+
+  const char * filename = get_cmdline_option(argv, argv + argc, "-f");
+  if (!filename) help_exit(argc, argv);
+
+  const char * n_jobs_str = get_cmdline_option(argv, argv + argc, "-n");
+  const size_t n_jobs = n_jobs_str ? std::atoi(n_jobs_str) : 8;
+
+  const char * n_threads_str = get_cmdline_option(argv, argv + argc, "-p");
+  const size_t n_threads = n_threads_str ? std::atoi(n_threads_str) : PCP::ParallelCsvParser::AUTO;
+
+  const char * n_workers_str = get_cmdline_option(argv, argv + argc, "-w");
+  const size_t n_workers = n_workers_str ? std::atoi(n_workers_str) : PCP::ParallelCsvParser::available_cpus();
+  if (n_jobs == 0 || n_workers == 0) help_exit(argc, argv);
+
+  const char * n_background_jobs_str = get_cmdline_option(argv, argv + argc, "-B");
+  const size_t n_background_jobs = n_background_jobs_str ? std::atoi(n_background_jobs_str) : 0;
+
+  PCP::ResourceGovernor governor;
+  const char * bytes_per_sec_str = get_cmdline_option(argv, argv + argc, "-l");
+  if (bytes_per_sec_str) governor.set_bytes_per_sec(std::strtoull(bytes_per_sec_str, NULL, 10));
+  const char * max_workers_str = get_cmdline_option(argv, argv + argc, "-W");
+  if (max_workers_str) governor.set_max_workers(std::atoi(max_workers_str));
+
+  PCP::CsvConfig csv_config(filename, false);
+  bench_warm_page_cache(filename);
+
+  PCP::Executor executor(n_workers);
+  const char * modes[] = {"thread per job", "shared executor"};
+  size_t n_expected_columns = 0;
+  for (size_t i_mode = 0; i_mode < 2; ++i_mode) {
+    PCP::LatencyHistogram job_latencies;
+    double elapsed_sec;
+    const size_t n_columns = run_jobs(csv_config, n_jobs, n_threads, i_mode == 0 ? NULL : &executor,
+                                      n_background_jobs, &governor, &job_latencies, &elapsed_sec);
+    if (i_mode == 0) n_expected_columns = n_columns;
+    else if (n_columns != n_expected_columns) {
+      std::cout << "NG. Parsed " << n_columns << " columns with " << modes[i_mode] << ", while "
+                << n_expected_columns << " columns are expected." << std::endl;
+      return 1;
+    }
+
+    std::cout << modes[i_mode] << ": " << n_jobs << " jobs in " << elapsed_sec << " sec, "
+              << csv_config.filesize() * n_jobs / elapsed_sec / 1024 / 1024 << " MB/s in total"
+              << ", job latency p50 " << job_latencies.get_percentile(50) / 1e6 << " ms"
+              << ", p99 " << job_latencies.get_percentile(99) / 1e6 << " ms"
+              << ", max " << job_latencies.get_max() / 1e6 << " ms" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,209 @@
+#ifndef BENCHMARK_MEMORY_PROFILE_HPP_
+#define BENCHMARK_MEMORY_PROFILE_HPP_
+
+/**
+ * Memory footprint of a benchmark: allocations by replacing global operator new / delete,
+ * peak RSS, and page cache residency of a mapped file sampled by mincore(2).
+ *
+ * Allocations are only counted when BENCH_ALLOC_PROFILE is defined, which replaces global operator new / delete
+ * (include it from only one translation unit then). It is off by default so that benchmarks measure the allocator users get.
+ */
+
+#include <iostream>
+#include <new>
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "benchmark.hpp"
+
+
+#ifdef BENCH_ALLOC_PROFILE
+
+/**
+ * Allocation counters. Only updated while _alloc_profiling is true,
+ * since shared counters add contention to allocations of worker threads.
+ */
+bool _alloc_profiling = false;
+size_t _n_allocations = 0, _allocated_bytes = 0;
+long _live_bytes = 0, _peak_live_bytes = 0;
+size_t _alloc_generation = 0;  // incremented by each alloc_profiling_start()
+
+/**
+ * Header placed before each block by operator new.
+ * Only blocks counted in live bytes in the current profiling session are subtracted at delete,
+ * so blocks allocated before alloc_profiling_start() do not make live bytes negative.
+ * 16 bytes keep the alignment malloc guarantees.
+ */
+typedef union alloc_header_t {
+  struct {
+    size_t counted_size;  ///< Size counted in _live_bytes.
+    size_t generation;  ///< _alloc_generation when counted, 0 if not counted.
+  } block;
+  char padding[16];
+} alloc_header_t;
+
+inline void _count_allocation(alloc_header_t * header, size_t size) {
+  header->block.counted_size = size;
+  header->block.generation = __atomic_load_n(&_alloc_generation, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&_n_allocations, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&_allocated_bytes, size, __ATOMIC_RELAXED);
+  const long live = __atomic_add_fetch(&_live_bytes, (long)size, __ATOMIC_RELAXED);
+  long peak = __atomic_load_n(&_peak_live_bytes, __ATOMIC_RELAXED);
+  while (live > peak && !__atomic_compare_exchange_n(&_peak_live_bytes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// memory from std::malloc() is returned by operator new, so std::free() in operator delete is not mismatched.
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void * operator new(size_t size) {
+  alloc_header_t * header = static_cast<alloc_header_t *>(std::malloc(sizeof(alloc_header_t) + size));
+  if (!header) throw std::bad_alloc();
+  header->block.generation = 0;
+  if (__atomic_load_n(&_alloc_profiling, __ATOMIC_RELAXED)) _count_allocation(header, size);
+  return header + 1;
+}
+
+void operator delete(void * p) throw() {
+  if (!p) return;
+  alloc_header_t * header = static_cast<alloc_header_t *>(p) - 1;
+  if (__atomic_load_n(&_alloc_profiling, __ATOMIC_RELAXED) && header->block.generation != 0 &&
+      header->block.generation == __atomic_load_n(&_alloc_generation, __ATOMIC_RELAXED))
+    __atomic_sub_fetch(&_live_bytes, (long)header->block.counted_size, __ATOMIC_RELAXED);
+  std::free(header);
+}
+
+void * operator new[](size_t size) { return operator new(size); }
+void operator delete[](void * p) throw() { operator delete(p); }
+#if __cplusplus >= 201402L
+void operator delete(void * p, size_t) throw() { operator delete(p); }
+void operator delete[](void * p, size_t) throw() { operator delete(p); }
+#endif
+
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+/**
+ * Start counting allocations from zero.
+ * Live bytes only include blocks allocated after this call.
+ */
+inline void alloc_profiling_start() {
+  _n_allocations = _allocated_bytes = 0;
+  _live_bytes = _peak_live_bytes = 0;
+  __atomic_add_fetch(&_alloc_generation, 1, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&_alloc_profiling, true, __ATOMIC_SEQ_CST);
+}
+
+inline void alloc_profiling_stop() {
+  __atomic_store_n(&_alloc_profiling, false, __ATOMIC_SEQ_CST);
+}
+
+#else
+
+inline void alloc_profiling_start() {}
+inline void alloc_profiling_stop() {}
+
+#endif /* BENCH_ALLOC_PROFILE */
+
+/**
+ * Return peak resident set size of this process in bytes.
+ */
+inline size_t peak_rss_bytes() {
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+  return ru.ru_maxrss;  // bytes
+#else
+  return ru.ru_maxrss * 1024;  // kilobytes
+#endif
+}
+
+/**
+ * Samples the number of pages of a mapped region resident in page cache by mincore(2) periodically in background.
+ */
+class ResidencySampler {
+public:
+  ResidencySampler(const void * addr, size_t length, useconds_t interval_usec = 10000)
+  : addr(addr), length(length), interval_usec(interval_usec), stopped(false), n_samples(0), max_resident_pages(0)
+  {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    n_pages = (length + page_size - 1) / page_size;
+    vec.resize(n_pages);
+    pthread_create(&tid, NULL, ResidencySampler::run, this);
+  }
+
+  /**
+   * Stop sampling after taking the last sample.
+   */
+  inline void stop() {
+    __atomic_store_n(&stopped, true, __ATOMIC_SEQ_CST);
+    pthread_join(tid, NULL);
+  }
+
+  inline size_t get_n_pages() const { return n_pages; }
+  inline size_t get_n_samples() const { return n_samples; }
+  inline size_t get_max_resident_pages() const { return max_resident_pages; }
+
+private:
+  const void * addr;
+  size_t length, n_pages;
+  useconds_t interval_usec;
+  std::vector<unsigned char> vec;
+  pthread_t tid;
+  bool stopped;
+  size_t n_samples, max_resident_pages;
+
+  inline void sample() {
+    // mincore(2) takes page-aligned address
+    const uintptr_t page_mask = ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+    if (mincore((void *)((uintptr_t)addr & page_mask), length, (unsigned char *)&vec[0]) != 0) return;
+    size_t n_resident = 0;
+    for (size_t i = 0; i < n_pages; ++i) n_resident += vec[i] & 1;
+    if (n_resident > max_resident_pages) max_resident_pages = n_resident;
+    ++n_samples;
+  }
+
+  static void * run(void * arg) {
+    ResidencySampler * self = static_cast<ResidencySampler *>(arg);
+    while (!__atomic_load_n(&self->stopped, __ATOMIC_SEQ_CST)) {
+      self->sample();
+      usleep(self->interval_usec);
+    }
+    self->sample();
+    return NULL;
+  }
+};
+
+/**
+ * Print allocations, peak RSS and page cache residency, and write them to JSON output of benchmark.hpp if opened.
+ */
+inline void memory_profile_report(const char * mode, const ResidencySampler & sampler) {
+#ifdef BENCH_ALLOC_PROFILE
+  std::cerr << "    " << _n_allocations << " allocations, " << _allocated_bytes << " bytes allocated, "
+            << _peak_live_bytes << " bytes peak live" << std::endl;
+#else
+  std::cerr << "    allocations not counted (built without BENCH_ALLOC_PROFILE)" << std::endl;
+#endif
+  std::cerr << "    " << peak_rss_bytes() << " bytes peak RSS, "
+            << sampler.get_max_resident_pages() << " / " << sampler.get_n_pages() << " pages of file resident in page cache at most ("
+            << sampler.get_n_samples() << " samples)" << std::endl;
+
+  if (!_bench_json.is_open()) return;
+  _bench_json << "{\"phase\":\"memory\",\"mode\":\"" << mode << "\"";
+#ifdef BENCH_ALLOC_PROFILE
+  _bench_json << ",\"allocations\":" << _n_allocations
+              << ",\"allocated_bytes\":" << _allocated_bytes << ",\"peak_live_bytes\":" << _peak_live_bytes;
+#endif
+  _bench_json << ",\"peak_rss_bytes\":" << peak_rss_bytes() << ",\"file_pages\":" << sampler.get_n_pages()
+              << ",\"max_resident_file_pages\":" << sampler.get_max_resident_pages() << "}" << std::endl;
+}
+
+
+#endif /* BENCHMARK_MEMORY_PROFILE_HPP_ */
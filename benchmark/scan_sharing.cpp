@@ -0,0 +1,88 @@
+/**
+ * Runs N aggregations over a CSV with a PCP::ParallelCsvParser pass for each,
+ * and with PCP::ParallelCsvParser::parse_shared() in one pass.
+ */
+
+#include <PartialCsvParser.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+#include "benchmark.hpp"
+#include "cmdline_options.hpp"
+
+
+/**
+ * Sum of lengths of a column, partial sums kept by each worker.
+ */
+class ColumnLengthSum : public PCP::StatefulScanConsumer<size_t> {
+public:
+  explicit ColumnLengthSum(size_t i_column)
+  : PCP::StatefulScanConsumer<size_t>(std::vector<size_t>(1, i_column)), sum(0)
+  {}
+
+  virtual void update(size_t & partial_sum, const PCP::ProjectedRow & row, size_t) { partial_sum += row[0].size(); }
+
+  virtual void finish() {
+    sum = 0;
+    for (size_t i = 0; i < get_n_states(); ++i) sum += get_state(i);
+  }
+
+  size_t sum;
+};
+
+inline void help_exit(int argc, char * argv[]) {
+  std::cerr << argv[0] << " [-h] -f FILENAME [-q N_QUERIES] [-p N_THREADS]" << std::endl;
+  std::cerr << "  FILENAME: CSV file without header" << std::endl;
+  std::cerr << "  N_QUERIES: number of aggregations, each summing lengths of a column (default: 4)" << std::endl;
+  std::cerr << "  N_THREADS: threads of ParallelCsvParser (default: ParallelCsvParser::AUTO)" << std::endl;
+  exit(2);
+}
+
+int main(int argc, char * argv[]) {
+  // command line options
+  if (cmdline_option_exists(argv, argv + argc, "-h")) help_exit(argc, argv);
+
+  const char * filename = get_cmdline_option(argv, argv + argc, "-f");
+  if (!filename) help_exit(argc, argv);
+
+  const char * n_queries_str = get_cmdline_option(argv, argv + argc, "-q");
+  const size_t n_queries = n_queries_str ? std::atoi(n_queries_str) : 4;
+
+  const char * n_threads_str = get_cmdline_option(argv, argv + argc, "-p");
+  const size_t n_threads = n_threads_str ? std::atoi(n_threads_str) : PCP::ParallelCsvParser::AUTO;
+  if (n_queries == 0) help_exit(argc, argv);
+
+  PCP::CsvConfig csv_config(filename, false);
+  bench_warm_page_cache(filename);
+
+  std::vector<std::unique_ptr<ColumnLengthSum> > separate, shared;
+  std::vector<PCP::ScanConsumer *> consumers;
+  for (size_t i = 0; i < n_queries; ++i) {
+    separate.push_back(std::unique_ptr<ColumnLengthSum>(new ColumnLengthSum(i % csv_config.get_n_columns())));
+    shared.push_back(std::unique_ptr<ColumnLengthSum>(new ColumnLengthSum(i % csv_config.get_n_columns())));
+    consumers.push_back(shared.back().get());
+  }
+
+  BENCH_START;
+  for (size_t i = 0; i < n_queries; ++i) {
+    PCP::ParallelCsvParser parser(csv_config, n_threads);
+    parser.parse_shared(std::vector<PCP::ScanConsumer *>(1, separate[i].get()));
+  }
+  BENCH_STOP_BYTES("parse for each query", csv_config.filesize() * n_queries);
+
+  BENCH_START;
+  PCP::ParallelCsvParser parser(csv_config, n_threads);
+  parser.parse_shared(consumers);
+  BENCH_STOP_BYTES("parse once for all queries", csv_config.filesize() * n_queries);
+
+  for (size_t i = 0; i < n_queries; ++i) {
+    if (separate[i]->sum != shared[i]->sum) {
+      std::cout << "NG. Query " << i << " got " << shared[i]->sum << " in shared scan, while " << separate[i]->sum << " is expected." << std::endl;
+      return 1;
+    }
+  }
+  std::cout << "OK. " << n_queries << " queries agree." << std::endl;
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * Replays many small in-memory CSVs through Memory::CsvConfig + PartialCsvParser
+ * and reports latency percentiles, like an online service parsing a request body.
+ */
+
+#include <PartialCsvParser.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include "cmdline_options.hpp"
+
+
+/**
+ * Generate \p n_payloads CSVs with header line, \p n_rows rows and \p n_columns columns.
+ * Field lengths vary among payloads so that allocations are not always the same.
+ */
+inline std::vector<std::string> generate_payloads(size_t n_payloads, size_t n_rows, size_t n_columns) {
+  std::vector<std::string> payloads(n_payloads);
+  for (size_t i = 0; i < n_payloads; ++i) {
+    std::ostringstream ss;
+    for (size_t col = 0; col < n_columns; ++col) ss << (col == 0 ? "" : ",") << "column" << col;
+    ss << "\n";
+    for (size_t row = 0; row < n_rows; ++row) {
+      for (size_t col = 0; col < n_columns; ++col)
+        ss << (col == 0 ? "" : ",") << std::string(1 + (i + row + col) % 24, 'a' + col % 26);
+      ss << "\n";
+    }
+    payloads[i] = ss.str();
+  }
+  return payloads;
+}
+
+inline void print_histogram(const char * name, const PCP::LatencyHistogram & histogram) {
+  std::cout << name << ": count " << histogram.get_count()
+            << ", mean " << histogram.get_mean() / 1000 << " us"
+            << ", p50 " << histogram.get_percentile(50) / 1000.0 << " us"
+            << ", p99 " << histogram.get_percentile(99) / 1000.0 << " us"
+            << ", p999 " << histogram.get_percentile(99.9) / 1000.0 << " us"
+            << ", max " << histogram.get_max() / 1000.0 << " us" << std::endl;
+}
+
+inline void help_exit(int argc, char * argv[]) {
+  std::cerr << argv[0] << " [-h] [-n N_PAYLOADS] [-r N_ROWS] [-c N_COLUMNS] [-a ALLOCATOR]" << std::endl;
+  std::cerr << "  N_PAYLOADS: number of CSVs to parse (default: 100000)" << std::endl;
+  std::cerr << "  N_ROWS: rows per CSV excluding header line (default: 10)" << std::endl;
+  std::cerr << "  N_COLUMNS: columns per row (default: 5)" << std::endl;
+  std::cerr << "  ALLOCATOR: new (default, get_row() returns new vector), reuse (get_row(row) reuses a vector among payloads)" << std::endl;
+  exit(2);
+}
+
+int main(int argc, char * argv[]) {
+  // command line options
+  if (cmdline_option_exists(argv, argv + argc, "-h")) help_exit(argc, argv);
+
+  const char * n_payloads_str = get_cmdline_option(argv, argv + argc, "-n");
+  const size_t n_payloads = n_payloads_str ? std::atoi(n_payloads_str) : 100000;
+
+  const char * n_rows_str = get_cmdline_option(argv, argv + argc, "-r");
+  const size_t n_rows = n_rows_str ? std::atoi(n_rows_str) : 10;
+
+  const char * n_columns_str = get_cmdline_option(argv, argv + argc, "-c");
+  const size_t n_columns = n_columns_str ? std::atoi(n_columns_str) : 5;
+
+  const char * allocator_str = get_cmdline_option(argv, argv + argc, "-a");
+  const std::string allocator = allocator_str ? allocator_str : "new";
+  if (n_payloads == 0 || n_columns == 0 || (allocator != "new" && allocator != "reuse")) help_exit(argc, argv);
+
+  const std::vector<std::string> payloads = generate_payloads(n_payloads, n_rows, n_columns);
+
+  // whole payload: header parsing in CsvConfig, parser construction and all get_row() calls
+  PCP::LatencyHistogram payload_latencies, header_latencies, get_row_latencies;
+  std::vector<std::string> row;
+  size_t n_total_columns = 0;
+  for (size_t i = 0; i < payloads.size(); ++i) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    PCP::Memory::CsvConfig csv_config(payloads[i].size(), payloads[i].data());
+    header_latencies.record(std::chrono::steady_clock::now() - start);
+
+    PCP::PartialCsvParser parser(csv_config);
+    parser.set_latency_histogram(&get_row_latencies);
+    if (allocator == "new") {
+      while (!(row = parser.get_row()).empty()) n_total_columns += row.size();
+    }
+    else {
+      while (parser.get_row(row)) n_total_columns += row.size();
+    }
+
+    payload_latencies.record(std::chrono::steady_clock::now() - start);
+  }
+
+  if (n_total_columns != n_payloads * n_rows * n_columns) {
+    std::cout << "NG. Parsed " << n_total_columns << " columns, while " << n_payloads * n_rows * n_columns << " columns are expected." << std::endl;
+    return 1;
+  }
+  print_histogram("payload", payload_latencies);
+  print_histogram("CsvConfig", header_latencies);
+  print_histogram("get_row", get_row_latencies);
+  return 0;
+}
@@ -0,0 +1,30 @@
+/**
+ * Parses a CSV file with 2 threads by ParallelCsvParser and print the contents with line numbers.
+ * Don't care if the output is mixed!
+ */
+
+#include <PartialCsvParser.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <mutex>
+
+int main() {
+  PCP::CsvConfig csv_config("english.csv");
+
+  // 2 threads, each takes 16 bytes chunks of CSV body.
+  PCP::ParallelCsvParser parser(csv_config, 2, 16);
+  parser.set_line_numbering(true);
+
+  // parse & print body lines
+  std::mutex cout_mutex;
+  parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    std::lock_guard<std::mutex> lock(cout_mutex);
+    std::cout << "Got a row at line " << line_number << ": ";
+    for (size_t i = 0; i < row.size(); ++i)
+      std::cout << row[i] << "\t";
+    std::cout << std::endl;
+  });
+
+  return 0;
+}
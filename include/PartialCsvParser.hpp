@@ -15,6 +15,7 @@
 #ifndef INCLUDE_PARTIALCSVPARSER_HPP_
 #define INCLUDE_PARTIALCSVPARSER_HPP_
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -22,11 +23,48 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
 #include <cerrno>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sched.h>
+
+// Parallel parser (C++11)
+#if __cplusplus >= 201103L
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#endif
+
+// Polymorphic memory resources (C++17) for rows and headers allocated from caller's pools
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define PCP_HAS_PMR
+#endif
+#endif
+
+// Coroutines (C++20) for async parsing
+#if __cplusplus >= 202002L && defined(__has_include) && defined(__cpp_impl_coroutine)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define PCP_HAS_COROUTINE
+#endif
+#endif
 
 // Prevent default class methods
 #define PREVENT_DEFAULT_CONSTRUCTOR(klass) \
@@ -40,6 +78,13 @@
   PREVENT_COPY_CONSTRUCTOR(klass); \
   PREVENT_OBJECT_ASSIGNMENT(klass); \
 
+// Dynamic exception specifications are deprecated in C++11 and ill-formed since C++17
+#if __cplusplus >= 201103L
+#define THROWS(err_class)
+#else
+#define THROWS(err_class) throw(err_class)
+#endif
+
 
 // Assertion also usable with Google Test
 #ifdef PCP_GTEST
@@ -99,14 +144,195 @@ public:
  */
 class PCPCsvError : public PCPError {
 public:
-  PCPCsvError(const std::string &cause)
+  PCPCsvError(const std::string &cause, size_t line_number = 0)
+  : PCPError(cause), line_number(line_number)
+  {}
+
+  /**
+   * Return 1-origin line number in CSV of the invalid line. 0 if unknown.
+   */
+  inline size_t get_line_number() const { return line_number; }
+
+private:
+  size_t line_number;
+};
+
+
+#if __cplusplus >= 201103L
+
+/**
+ * Thrown when parsing is cancelled by CancellationToken.
+ */
+class PCPCancelledError : public PCPError {
+public:
+  PCPCancelledError(const std::string &cause)
   : PCPError(cause)
   {}
 };
 
+/**
+ * Token to cancel parsing from another thread, or by deadline.
+ *
+ * Parsers check it by a relaxed atomic load for every chunk (or at the first line and every PartialCsvParser::CANCELLATION_CHECK_INTERVAL lines),
+ * and throw PCPCancelledError. So cancellation is not immediate but costs almost nothing.
+ */
+class CancellationToken {
+public:
+  typedef std::chrono::steady_clock clock;
+
+  CancellationToken()
+  : cancelled(false), deadline_ticks(NO_DEADLINE)
+  {}
+
+  /**
+   * Request parsers to stop. Thread-safe.
+   */
+  inline void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+  /**
+   * Cancel parsing when \p deadline has passed. Thread-safe.
+   */
+  inline void set_deadline(clock::time_point deadline) {
+    deadline_ticks.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+  }
+
+  /**
+   * Cancel parsing when \p timeout has passed from now. Thread-safe.
+   */
+  template <class Rep, class Period>
+  inline void set_timeout(const std::chrono::duration<Rep, Period> & timeout) {
+    set_deadline(clock::now() + std::chrono::duration_cast<clock::duration>(timeout));
+  }
+
+  /**
+   * Return true if cancel() is called or deadline has passed.
+   */
+  inline bool is_cancelled() const {
+    if (cancelled.load(std::memory_order_relaxed)) return true;
+    const clock::rep deadline = deadline_ticks.load(std::memory_order_relaxed);
+    if (deadline != NO_DEADLINE && clock::now().time_since_epoch().count() >= deadline) {
+      cancelled.store(true, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+private:
+  static const clock::rep NO_DEADLINE = -1;
+
+  mutable std::atomic<bool> cancelled;
+  std::atomic<clock::rep> deadline_ticks;
+
+  PREVENT_COPY_CONSTRUCTOR(CancellationToken);
+  PREVENT_OBJECT_ASSIGNMENT(CancellationToken);
+};
+
+/**
+ * Histogram of latencies in nanoseconds, in the manner of HdrHistogram.
+ *
+ * Values are counted in log-linear buckets: 2^SUB_BUCKET_BITS buckets per power of 2,
+ * so reported percentiles are within 1 / 2^SUB_BUCKET_BITS (< 1%) of exact values, in constant memory.
+ * Recording is not thread-safe. Record to a histogram per thread and merge() them.
+ */
+class LatencyHistogram {
+public:
+  static const unsigned int SUB_BUCKET_BITS = 7;
+  static const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  static const unsigned int MAX_VALUE_BITS = 44;  ///< Larger values (> 4.8 hours) are recorded as 2^MAX_VALUE_BITS - 1.
+
+  LatencyHistogram()
+  : counts(bucket_index((uint64_t(1) << MAX_VALUE_BITS) - 1) + 1, 0), total_count(0), sum(0), min_value(0), max_value(0)
+  {}
+
+  /**
+   * Record a latency of \p ns nanoseconds.
+   */
+  inline void record(uint64_t ns) {
+    if (ns >= (uint64_t(1) << MAX_VALUE_BITS)) ns = (uint64_t(1) << MAX_VALUE_BITS) - 1;
+    ++counts[bucket_index(ns)];
+    if (total_count == 0 || ns < min_value) min_value = ns;
+    if (ns > max_value) max_value = ns;
+    ++total_count;
+    sum += ns;
+  }
+
+  template <class Rep, class Period>
+  inline void record(const std::chrono::duration<Rep, Period> & latency) {
+    const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+    record(ns < 0 ? 0 : uint64_t(ns));
+  }
+
+  /**
+   * Add up all values recorded in \p other.
+   */
+  inline void merge(const LatencyHistogram & other) {
+    if (other.total_count == 0) return;
+    for (size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+    if (total_count == 0 || other.min_value < min_value) min_value = other.min_value;
+    if (other.max_value > max_value) max_value = other.max_value;
+    total_count += other.total_count;
+    sum += other.sum;
+  }
+
+  inline void clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total_count = sum = min_value = max_value = 0;
+  }
+
+  inline uint64_t get_count() const { return total_count; }
+  inline uint64_t get_min() const { return min_value; }
+  inline uint64_t get_max() const { return max_value; }
+  inline double get_mean() const { return total_count == 0 ? 0 : double(sum) / total_count; }
+
+  /**
+   * Return the value at \p percentile (0 ~ 100), e.g. 99.9 for p999.
+   * The largest value in the bucket is returned, so it is never smaller than the exact value (except for get_max()).
+   */
+  inline uint64_t get_percentile(double percentile) const {
+    if (total_count == 0) return 0;
+    uint64_t rank = uint64_t(percentile / 100 * total_count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total_count) rank = total_count;
+    uint64_t n = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      n += counts[i];
+      if (n >= rank) return std::min(std::max(highest_value_of_bucket(i), min_value), max_value);
+    }
+    return max_value;
+  }
+
+private:
+  std::vector<uint64_t> counts;
+  uint64_t total_count, sum, min_value, max_value;
+
+  /**
+   * Values < SUB_BUCKET_COUNT have their own buckets. Each [2^k, 2^(k+1)) above is divided into SUB_BUCKET_COUNT buckets.
+   */
+  static inline size_t bucket_index(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) return value;
+    unsigned int msb = 0;
+#if defined(__GNUC__)
+    msb = 63 - __builtin_clzll(value);
+#else
+    for (uint64_t v = value; v >>= 1; ) ++msb;
+#endif
+    const unsigned int shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT);
+  }
+
+  static inline uint64_t highest_value_of_bucket(size_t index) {
+    if (index < SUB_BUCKET_COUNT) return index;
+    const unsigned int shift = index / SUB_BUCKET_COUNT - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    return ((sub_bucket + 1) << shift) - 1;
+  }
+};
+
+#endif /* __cplusplus >= 201103L */
+
 
 // Utility functions
-inline size_t _filesize(int opened_fd) throw(PCPError) {
+inline size_t _filesize(int opened_fd) THROWS(PCPError) {
   struct stat st;
   if (fstat(opened_fd, &st) != 0) STRERROR_THROW(PCPError, "while getting stat(2) of file");
   return st.st_size;
@@ -167,27 +393,210 @@ inline void _get_current_line(
   *line_length_byte = line_end - line_start;
 }
 
-inline std::vector<std::string> _split(const char * const str, size_t len, char delimiter) {
+/**
+ * Set \p str of \p len bytes to \p i-th column of \p row.
+ * Existing columns are overwritten in place so that their buffers (allocated by \p row's allocator) are reused.
+ */
+template <class Row>
+inline void _set_column(Row & row, size_t i, const char * const str, size_t len) {
+  if (i >= row.size()) row.resize(i + 1);  // new column is constructed with row's allocator
+  row[i].assign(str, len);
+}
+
+/**
+ * Return \p c broadcast to every byte of a word, to be compared by _swar_match().
+ */
+inline unsigned long long _swar_broadcast(char c) {
+  return 0x0101010101010101ULL * static_cast<unsigned char>(c);
+}
+
+/**
+ * Compare 8 bytes of \p word with bytes of \p pattern at once (SWAR).
+ * @return 0x80 for each matched byte and 0x00 for others. Exact, without false positives.
+ */
+inline unsigned long long _swar_match(unsigned long long word, unsigned long long pattern) {
+  const unsigned long long LOW7 = 0x7f7f7f7f7f7f7f7fULL;
+  const unsigned long long x = word ^ pattern;  // matched bytes are 0x00
+  return ~(((x & LOW7) + LOW7) | x | LOW7);
+}
+
+/**
+ * Narrow [\p *begin, \p *end) to exclude leading and trailing spaces and tabs, without copying.
+ * Long runs of padding are skipped 8 bytes at once (SWAR).
+ */
+inline void _trim_whitespaces(/* inout */ const char ** begin, const char ** end) {
+  const unsigned long long SPACES = _swar_broadcast(' '), TABS = _swar_broadcast('\t'), ALL_MATCHED = _swar_broadcast('\x80');
+  const char * b = *begin, * e = *end;
+  unsigned long long word;
+
+  for (; e - b >= static_cast<ptrdiff_t>(sizeof(word)); b += sizeof(word)) {
+    std::memcpy(&word, b, sizeof(word));
+    if ((_swar_match(word, SPACES) | _swar_match(word, TABS)) != ALL_MATCHED) break;
+  }
+  while (b < e && (*b == ' ' || *b == '\t')) ++b;
+
+  for (; e - b >= static_cast<ptrdiff_t>(sizeof(word)); e -= sizeof(word)) {
+    std::memcpy(&word, e - sizeof(word), sizeof(word));
+    if ((_swar_match(word, SPACES) | _swar_match(word, TABS)) != ALL_MATCHED) break;
+  }
+  while (e > b && (*(e - 1) == ' ' || *(e - 1) == '\t')) --e;
+
+  *begin = b;
+  *end = e;
+}
+
+/**
+ * Set [\p begin, \p end) to \p i-th column of \p row like _set_column(), excluding leading and trailing spaces and tabs if \p trim_whitespaces.
+ */
+template <class Row>
+inline void _set_column(Row & row, size_t i, const char * begin, const char * end, bool trim_whitespaces) {
+  if (trim_whitespaces) _trim_whitespaces(&begin, &end);
+  _set_column(row, i, begin, end - begin);
+}
+
+/**
+ * Split \p str into \p row.
+ * @param[out] row Container of strings (e.g. std::vector<std::string> or std::pmr::vector<std::pmr::string>).
+ *   Its elements are reused and it is resized to the number of columns.
+ * @param trim_whitespaces If true, leading and trailing spaces and tabs of each column are excluded.
+ */
+template <class Row>
+inline void _split(const char * const str, size_t len, char delimiter, /* out */ Row & row, bool trim_whitespaces = false) {
   ASSERT(str);
   ASSERT(len >= 0);
 
-  std::vector<std::string> ret;  // NRVO optimization may prevent copy when returning this local variable.
-
+  size_t n_columns = 0;
   const char *p_beg = str, *p_end = str;
   while (p_end - str < len) {
     // come to delimiter
     if (*p_end == delimiter) {
-      ret.push_back(std::string(p_beg, p_end - p_beg));
+      _set_column(row, n_columns++, p_beg, p_end, trim_whitespaces);
       p_beg = p_end + 1;
     }
     ++p_end;
   }
   // come to end of str
-  ret.push_back(std::string(p_beg, p_end - p_beg));
+  _set_column(row, n_columns++, p_beg, p_end, trim_whitespaces);
+  row.resize(n_columns);
+}
+
+inline std::vector<std::string> _split(const char * const str, size_t len, char delimiter) {
+  std::vector<std::string> ret;  // NRVO optimization may prevent copy when returning this local variable.
+  _split(str, len, delimiter, ret);
   return ret;
 }
 
 
+/**
+ * Count occurrences of \p c in \p text.
+ * 8 bytes are compared at once (SWAR) and matched bytes are counted by popcount.
+ */
+inline size_t _count_char(const char * const text, size_t text_length_byte, char c) {
+  const unsigned long long pattern = _swar_broadcast(c);
+
+  size_t count = 0, i = 0;
+  for (; i + sizeof(unsigned long long) <= text_length_byte; i += sizeof(unsigned long long)) {
+    unsigned long long word;
+    std::memcpy(&word, text + i, sizeof(word));
+    const unsigned long long matched = _swar_match(word, pattern);
+#if defined(__GNUC__)
+    count += __builtin_popcountll(matched);
+#else
+    for (unsigned long long m = matched; m; m &= m - 1) ++count;
+#endif
+  }
+  for (; i < text_length_byte; ++i) count += (text[i] == c);
+  return count;
+}
+
+/**
+ * Find the first occurrence of multi-byte \p delimiter in \p str from \p pos.
+ * Candidates are found by comparing 8 bytes with the first byte of \p delimiter at once (SWAR), then verified by std::memcmp.
+ * Unlike _find_pattern(), no function is called for a run of bytes without candidates, which is faster for short columns.
+ * @return Offset of the occurrence, or \p len if not found.
+ */
+inline size_t _find_delimiter(const char * const str, size_t len, size_t pos, const std::string & delimiter) {
+  ASSERT(delimiter.size() >= 1);
+
+  const size_t delimiter_length = delimiter.size();
+  const unsigned long long first = _swar_broadcast(delimiter[0]);
+  while (pos + delimiter_length <= len) {
+    if (pos + sizeof(unsigned long long) <= len) {
+      unsigned long long word;
+      std::memcpy(&word, str + pos, sizeof(word));
+      if (!_swar_match(word, first)) {  // no candidate in these 8 bytes
+        pos += sizeof(unsigned long long);
+        continue;
+      }
+    }
+    // verify candidates in these 8 bytes
+    for (const size_t block_end = std::min(pos + sizeof(unsigned long long), len - delimiter_length + 1); pos < block_end; ++pos) {
+      if (str[pos] == delimiter[0] && std::memcmp(str + pos + 1, delimiter.data() + 1, delimiter_length - 1) == 0) return pos;
+    }
+  }
+  return len;
+}
+
+/**
+ * Split \p str into \p row by \p delimiter, which may have multiple bytes (e.g. "||").
+ * Occurrences of \p delimiter are found from left without overlaps. A single-byte \p delimiter is split by _split(const char * const, size_t, char, Row &, bool).
+ */
+template <class Row>
+inline void _split(const char * const str, size_t len, const std::string & delimiter, /* out */ Row & row, bool trim_whitespaces = false) {
+  if (delimiter.size() == 1) {
+    _split(str, len, delimiter[0], row, trim_whitespaces);
+    return;
+  }
+
+  size_t n_columns = 0, beg = 0, end;
+  while ((end = _find_delimiter(str, len, beg, delimiter)) < len) {
+    _set_column(row, n_columns++, str + beg, str + end, trim_whitespaces);
+    beg = end + delimiter.size();
+  }
+  _set_column(row, n_columns++, str + beg, str + len, trim_whitespaces);
+  row.resize(n_columns);
+}
+
+/**
+ * Count occurrences of \p delimiter in \p text without overlaps, which may have multiple bytes.
+ */
+inline size_t _count_delimiter(const char * const text, size_t text_length_byte, const std::string & delimiter) {
+  if (delimiter.size() == 1) return _count_char(text, text_length_byte, delimiter[0]);
+
+  size_t count = 0;
+  for (size_t pos = 0; (pos = _find_delimiter(text, text_length_byte, pos, delimiter)) < text_length_byte; pos += delimiter.size()) ++count;
+  return count;
+}
+
+/**
+ * Find first occurrence of \p pattern in \p text.
+ * Candidates are found by std::memchr (vectorized in most libc) with first byte of \p pattern, then verified by std::memcmp.
+ * @return Pointer to the occurrence, or NULL if not found.
+ */
+inline const char * _find_pattern(const char * const text, size_t text_length_byte, const char * const pattern, size_t pattern_length_byte) {
+  ASSERT(pattern_length_byte >= 1);
+
+  const char * p = text, * const last = text + text_length_byte;
+  while (static_cast<size_t>(last - p) >= pattern_length_byte) {
+    p = static_cast<const char *>(std::memchr(p, pattern[0], (last - p) - pattern_length_byte + 1));
+    if (!p) return NULL;
+    if (std::memcmp(p + 1, pattern + 1, pattern_length_byte - 1) == 0) return p;
+    ++p;
+  }
+  return NULL;
+}
+
+/**
+ * Return offset of the first line beginning at or after \p pos, or \p text_length_byte if no line begins there.
+ * A line beginning at \p pos is owned by the parser whose range covers \p pos, and a line across \p pos is owned by the previous one.
+ */
+inline size_t _line_beginning_from(const char * const text, size_t text_length_byte, size_t pos, char line_terminator) {
+  if (pos == 0 || pos >= text_length_byte || text[pos - 1] == line_terminator) return std::min(pos, text_length_byte);
+  const char * line_end = static_cast<const char *>(std::memchr(text + pos, line_terminator, text_length_byte - pos));
+  return line_end ? line_end - text + 1 : text_length_byte;
+}
+
+
 namespace Memory { class CsvConfig; }
 class CsvConfig;
 class PartialCsvParser;
@@ -216,9 +625,10 @@ public:
     char line_terminator = '\n',
     bool _lazy_initialization = false)
   : has_header_line(has_header_line),
-    field_terminator(field_terminator), line_terminator(line_terminator),
+    field_terminator(field_terminator), field_terminator_string(1, field_terminator), line_terminator(line_terminator),
+    comment_prefix(0), skip_blank_lines(false), trim_whitespaces(false),
     csv_text(str_with_null_terminator),
-    n_columns(0)
+    header_offset(0), n_columns(0)
   {
     assert_utf8_compatibility();
 
@@ -244,9 +654,10 @@ public:
     char field_terminator = ',',
     char line_terminator = '\n')
   : has_header_line(has_header_line),
-    field_terminator(field_terminator), line_terminator(line_terminator),
+    field_terminator(field_terminator), field_terminator_string(1, field_terminator), line_terminator(line_terminator),
+    comment_prefix(0), skip_blank_lines(false), trim_whitespaces(false),
     csv_size(str_length), csv_text(str),
-    n_columns(0)
+    header_offset(0), n_columns(0)
   {
     ASSERT(str_length > 0);
     ASSERT(str);
@@ -277,7 +688,7 @@ public:
    */
   inline size_t body_offset() const {
     if (!has_header_line) return 0;
-    return header_length + 1;
+    return header_offset + header_length + 1;
   }
 
   /**
@@ -290,9 +701,82 @@ public:
   }
 
   /**
-   * Return a character to separate columns.
+   * Set header strings to \p headers.
+   * \p has_header_line flag must be set true in constructor.
+   * @param[out] headers Container of strings allocated by its own allocator (e.g. std::pmr::vector<std::pmr::string>).
+   */
+  template <class Row>
+  inline void get_headers(/* out */ Row & headers) const {
+    ASSERT(has_header_line);
+    _split(csv_text + header_offset, header_length, field_terminator_string, headers, trim_whitespaces);
+  }
+
+  /**
+   * Skip lines starting with \p prefix (e.g. '#') as comments.
+   * Comment lines before header line are also skipped.
+   * Call it before creating parsers.
+   * @param prefix Character to start comment lines. '\0' disables comment lines (default).
+   */
+  inline void set_comment_prefix(char prefix) {
+    ASSERT(0 <= prefix); ASSERT(prefix <= 127);
+    comment_prefix = prefix;
+    init();
+  }
+
+  /**
+   * Skip empty lines (disabled by default).
+   * Empty lines before header line are also skipped.
+   * Call it before creating parsers.
+   */
+  inline void set_skip_blank_lines(bool skip) {
+    skip_blank_lines = skip;
+    init();
+  }
+
+  /**
+   * Exclude leading and trailing spaces and tabs of each column (disabled by default), e.g. "  123 , foo  " is split into "123" and "foo".
+   * Padding is excluded while splitting, before columns are copied to rows.
+   * Headers are also trimmed.
+   * Call it before creating parsers.
+   */
+  inline void set_trim_whitespaces(bool trim) {
+    trim_whitespaces = trim;
+    init();
+  }
+
+  inline bool get_trim_whitespaces() const { return trim_whitespaces; }
+
+  /**
+   * Return true if the line is skipped as a comment or an empty line.
+   */
+  inline bool is_skipped_line(const char * const line, size_t line_length_byte) const {
+    if (line_length_byte == 0) return skip_blank_lines;
+    return comment_prefix != 0 && line[0] == comment_prefix;
+  }
+  /**
+   * Separate columns by \p terminator, which may have multiple bytes (e.g. "||" or "~|~") when columns contain single-byte separators.
+   * Call it before creating parsers.
+   * @param terminator Bytes to separate columns. For UTF-8 compatibility, only 1 ~ 127 are allowed, and line terminator is not allowed.
+   */
+  inline void set_field_terminator(const std::string & terminator) {
+    ASSERT(!terminator.empty());
+    for (size_t i = 0; i < terminator.size(); ++i) {
+      ASSERT(0 < terminator[i]); ASSERT(terminator[i] <= 127);
+      ASSERT(terminator[i] != line_terminator);
+    }
+    field_terminator = terminator[0];
+    field_terminator_string = terminator;
+    init();
+  }
+
+  /**
+   * Return a character to separate columns, or its first byte if set_field_terminator() sets multiple bytes.
    */
   inline const char get_field_terminator() const { return field_terminator; }
+  /**
+   * Return bytes to separate columns.
+   */
+  inline const std::string & get_field_terminator_string() const { return field_terminator_string; }
   /**
    * Return a character to separate rows.
    */
@@ -300,27 +784,40 @@ public:
 
 protected:
   const bool has_header_line;
-  const char field_terminator;
+  char field_terminator;
+  std::string field_terminator_string;
   const char line_terminator;
 
+  char comment_prefix;
+  bool skip_blank_lines;
+  bool trim_whitespaces;
+
   size_t csv_size;
   const char * csv_text;
 
   std::vector<std::string> headers;
+  size_t header_offset;
   size_t header_length;
 
   size_t n_columns;
 
   inline void init() {
-    // parse first line to calculate n_columns
+    // parse first line (except comment lines and empty lines to skip) to calculate n_columns
     const char * line = 0;
     size_t line_length = 0;
-    _get_current_line(csv_text, csv_size, 0, line_terminator, &line, &line_length);
-    std::vector<std::string> columns = _split(line, line_length, field_terminator);
+    size_t pos = 0;
+    while (true) {
+      _get_current_line(csv_text, csv_size, pos, line_terminator, &line, &line_length);
+      pos = (line - csv_text) + line_length + 1;  // +1 is from line_delimitor
+      if (!is_skipped_line(line, line_length) || pos >= csv_size) break;
+    }
+    std::vector<std::string> columns;
+    _split(line, line_length, field_terminator_string, columns, trim_whitespaces);
     n_columns = columns.size();
 
     // set headers if exist
     if (has_header_line) {
+      header_offset = line - csv_text;
       header_length = line_length;
       headers = columns;
     }
@@ -355,7 +852,7 @@ public:
     bool has_header_line = true,
     char field_terminator = ',',
     char line_terminator = '\n')
-  throw(PCPError)
+  THROWS(PCPError)
   : Memory::CsvConfig(0, has_header_line, field_terminator, line_terminator, true)
   {
     if ((fd = open(filepath, O_RDONLY)) == -1)
@@ -392,6 +889,19 @@ typedef struct partial_csv_t {
 } partial_csv_t;
 
 
+#ifdef PCP_HAS_PMR
+namespace pmr {
+
+/**
+ * Array of columns allocated from std::pmr::memory_resource.
+ * Pass it to PartialCsvParser::get_row(Row &) or CsvConfig::get_headers(Row &).
+ */
+typedef std::pmr::vector<std::pmr::string> row_t;
+
+}
+#endif
+
+
 /**
  * Parser to split CSV into rows and columns.
  */
@@ -441,11 +951,17 @@ public:
     const Memory::CsvConfig & csv_config,
     size_t parse_from = PARSE_FROM_BODY_BEGINNING,
     size_t parse_to = PARSE_TO_FILE_END)
-  : csv_config(csv_config), parse_from(parse_from), parse_to(parse_to)
+  : csv_config(csv_config), parse_from(parse_from), parse_to(parse_to),
+    n_terminators(0), last_line_n_terminators(0), line_number_base(LINE_NUMBER_UNKNOWN),
+    filter_search_end(0), filter_window_end(0)
+#if __cplusplus >= 201103L
+    , cancellation_token(NULL), n_lines_to_check_cancellation(1), latency_histogram(NULL)
+#endif
   {
     if (parse_from == PARSE_FROM_BODY_BEGINNING) this->parse_from = csv_config.body_offset();
     if (parse_to == PARSE_TO_FILE_END) this->parse_to = csv_config.filesize() - 1;
     cur_pos = this->parse_from;
+    if (this->parse_from == 0) line_number_base = 0;
     ASSERT(csv_config.body_offset() <= this->parse_from);
     ASSERT(this->parse_to < csv_config.filesize());
     // Do not assert this->parse_from <= this->parse_to.
@@ -456,66 +972,2895 @@ public:
   ~PartialCsvParser() {}
 
   /**
-   * Returns an array of parsed columns.
-   * Parses only around [\p parse_from, \p parse_to) specified in constructor is parsed.
-   * @return Array of columns if line to parse remains. Otherwise, empty vector is returned. Check by \p retval.empty().
+   * Return 1-origin line number in CSV of the line last parsed by get_row() or validate().
+   *
+   * Line number is counted from \p parse_from while parsing.
+   * If \p parse_from is not 0 and set_line_number_base() is not called,
+   * line terminators before \p parse_from are counted at the first call, which takes O(\p parse_from) time.
    */
-  inline std::vector<std::string> get_row() throw(PCPCsvError) {
-    while (cur_pos <= parse_to) {
-      const char * line;
-      size_t line_length;
-      _get_current_line(csv_config.content(), csv_config.filesize(), cur_pos, csv_config.get_line_terminator(), &line, &line_length);
+  inline size_t get_line_number() {
+    if (line_number_base == LINE_NUMBER_UNKNOWN)
+      line_number_base = _count_char(csv_config.content(), parse_from, csv_config.get_line_terminator());
+    return line_number_base + last_line_n_terminators + 1;
+  }
 
-      // cur_pos exactly is the beginning of current line.
-      //
-      // (\n or beginning of CSV file)  aaaaaaaaaaaaaa \n
-      //                                <----...
-      //                                cur_pos
-      //
-      // Parse "aaaaaaaaaaaaaa" and move cur_pos to the beginning of the next line.
-      if (csv_config.content() + cur_pos == line) {
-        cur_pos += line_length + 1;  // +1 is from line_delimitor
-
-        const std::vector<std::string> & columns = _split(line, line_length, csv_config.get_field_terminator());
-        if (columns.size() != csv_config.get_n_columns()) {
-          std::ostringstream ss; \
-          ss << "The following line has " << columns.size() << " columns, while the first line has " << csv_config.get_n_columns() << " columns." << std::endl << std::string(line, line_length);
-          throw PCPCsvError(ss.str());
-        }
-        return columns;
+  /**
+   * Give the number of line terminators before \p parse_from to get_line_number().
+   * Parallel parsers can calculate it cheaply by prefix sum of the number of line terminators in their ranges.
+   */
+  inline void set_line_number_base(size_t n_line_terminators_before_parse_from) {
+    line_number_base = n_line_terminators_before_parse_from;
+  }
+
+  /**
+   * Check the number of columns of each line without splitting it into columns.
+   * Parses the same lines as get_row() does but only counts field terminators in each line, which is much faster.
+   * Line filter set by set_line_filter() is ignored.
+   * @param[out] invalid_line_offsets Offsets of the beginnings of lines whose number of columns differs from CsvConfig::get_n_columns() are appended.
+   * @return Number of validated lines.
+   */
+  inline size_t validate(/* out */ std::vector<size_t> & invalid_line_offsets) {
+    const char * const text = csv_config.content();
+    const size_t text_length = csv_config.filesize();
+    const std::string & field_terminator = csv_config.get_field_terminator_string();
+    const char line_terminator = csv_config.get_line_terminator();
+    const size_t n_field_terminators = csv_config.get_n_columns() - 1;
+
+    const char * line;
+    size_t line_length;
+    if (!next_line(&line, &line_length)) return 0;
+
+    size_t n_lines = 0;
+    while (true) {
+      check_cancellation();
+      if (!csv_config.is_skipped_line(line, line_length)) {
+        ++n_lines;
+        if (_count_delimiter(line, line_length, field_terminator) != n_field_terminators)
+          invalid_line_offsets.push_back(line - text);
       }
 
-      // parse_to is at the same line with cur_pos.
-      //
-      // (\n or beginning of CSV file)  aaaaaaaaaaaaaa \n
-      //                                    <---------->
-      //                                    cur_pos    parse_to
-      if (csv_config.content() + parse_to < line + line_length + 1)  // +1 is from line_delimitor
-        return std::vector<std::string>(0);
+      // cur_pos exactly is the beginning of next line after next_line().
+      if (cur_pos > parse_to) break;
+      line = text + cur_pos;
+      const char * line_end = static_cast<const char *>(std::memchr(line, line_terminator, text_length - cur_pos));
+      line_length = line_end ? line_end - line : text_length - cur_pos;
+      cur_pos += line_length + 1;  // +1 is from line_delimitor
+      last_line_n_terminators = n_terminators++;
+    }
+    return n_lines;
+  }
 
-      // parse_to is beyond the same line with cur_pos.
-      //
-      // (\n or beginning of CSV file)  aaaaaaaaaaaaaa \n bbbbbbbbbb
-      //                                    <--------------...
-      //                                    cur_pos
-      //
-      // Move cur_pos to the beginning of the next line.
-      if (csv_config.content() + parse_to >= line + line_length + 1)  // +1 is from line_delimitor
-        cur_pos = (line - csv_config.content()) + line_length + 1;  // +1 is from line_delimitor
+#if __cplusplus >= 201103L
+  /**
+   * Number of lines parsed between checks of CancellationToken.
+   */
+  static const size_t CANCELLATION_CHECK_INTERVAL = 1024;
+
+  /**
+   * Make get_row() and validate() throw PCPCancelledError once \p token is cancelled.
+   * @param token Checked at the next line and then every CANCELLATION_CHECK_INTERVAL lines, including lines skipped as comments or by line filter.
+   *   Also checked every 1 MiB searched by line filter. NULL disables cancellation.
+   */
+  inline void set_cancellation_token(const CancellationToken * token) {
+    cancellation_token = token;
+    n_lines_to_check_cancellation = 1;  // an already cancelled token stops the next line
+  }
+
+  /**
+   * Record latency of each get_row() call to \p histogram.
+   * @param histogram Owned by caller, and must not be shared with parsers in other threads. NULL disables recording (default).
+   */
+  inline void set_latency_histogram(LatencyHistogram * histogram) { latency_histogram = histogram; }
+#endif
+
+  /**
+   * Skip lines not including any of \p patterns before splitting them into columns.
+   *
+   * Patterns are searched over raw bytes from the current position to the end of the range,
+   * so non-matching lines are skipped without scanning line terminators one by one.
+   * Since a pattern may match across columns (e.g. "a,b"), check the columns of returned rows if exact column-level condition is necessary.
+   *
+   * @param patterns Literal strings. Each must be non-empty and must not include line terminator.
+   *   Empty array disables the filter.
+   */
+  inline void set_line_filter(const std::vector<std::string> & patterns) {
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      ASSERT(!patterns[i].empty());
+      ASSERT(patterns[i].find(csv_config.get_line_terminator()) == std::string::npos);
+    }
+    filter_patterns = patterns;
+    filter_next_hits.clear();
+    filter_search_end = filter_window_end = 0;
+  }
+
+  /**
+   * Returns an array of parsed columns.
+   * Parses only around [\p parse_from, \p parse_to) specified in constructor is parsed.
+   * @return Array of columns if line to parse remains. Otherwise, empty vector is returned. Check by \p retval.empty().
+   */
+  inline std::vector<std::string> get_row() THROWS(PCPCsvError) {
+    std::vector<std::string> row;
+    get_row(row);
+    return row;
+  }
+
+  /**
+   * Set parsed columns to \p row.
+   * Buffers of \p row are reused among calls, and new columns are allocated with \p row's allocator.
+   * Pass std::pmr::vector<std::pmr::string> to allocate columns from your std::pmr::memory_resource.
+   * @param[out] row Container of strings. Cleared if no line to parse remains.
+   * @return true if a row is parsed. Otherwise, false.
+   */
+  template <class Row>
+  inline bool get_row(/* out */ Row & row) THROWS(PCPCsvError) {
+#if __cplusplus >= 201103L
+    if (latency_histogram) {
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      const bool parsed = parse_row(row);
+      latency_histogram->record(std::chrono::steady_clock::now() - start);
+      return parsed;
     }
-    return std::vector<std::string>(0);
+#endif
+    return parse_row(row);
   }
 
 private:
   static const size_t PARSE_FROM_BODY_BEGINNING = -1;
   static const size_t PARSE_TO_FILE_END = -1;
 
+  /**
+   * Body of get_row(Row &).
+   */
+  template <class Row>
+  inline bool parse_row(/* out */ Row & row) THROWS(PCPCsvError) {
+    const char * line;
+    size_t line_length;
+    if (!(filter_patterns.empty() ? next_line(&line, &line_length) : next_filtered_line(&line, &line_length))) {
+      row.clear();
+      return false;
+    }
+
+    _split(line, line_length, csv_config.get_field_terminator_string(), row, csv_config.get_trim_whitespaces());
+    if (row.size() != csv_config.get_n_columns()) {
+      const size_t line_number = get_line_number();
+      std::ostringstream ss;
+      ss << "The following line (line " << line_number << ") has " << row.size() << " columns, while the first line has " << csv_config.get_n_columns() << " columns." << std::endl << std::string(line, line_length);
+      throw PCPCsvError(ss.str(), line_number);
+    }
+    return true;
+  }
+
   const Memory::CsvConfig & csv_config;
   size_t parse_from, parse_to;
   size_t cur_pos;
 
-  PREVENT_CLASS_DEFAULT_METHODS(PartialCsvParser);
-};
+  size_t n_terminators;  // number of line terminators in [parse_from, cur_pos)
+  size_t last_line_n_terminators;  // number of line terminators in [parse_from, beginning of line last parsed)
+  size_t line_number_base;  // number of line terminators in [0, parse_from)
+
+  static const size_t LINE_NUMBER_UNKNOWN = -1;
+
+  std::vector<std::string> filter_patterns;
+  std::vector<size_t> filter_next_hits;  // offset of next occurrence of each pattern (NO_HIT if none)
+  size_t filter_search_end;  // end of the line including parse_to
+  size_t filter_window_end;  // filter_next_hits are searched until here
+
+  static const size_t NO_HIT = -1;
+
+  /**
+   * Line filter searches patterns by windows of this size, so that cancellation is checked even if patterns are rare.
+   */
+  enum { FILTER_SEARCH_WINDOW = 1 << 20 };
+
+#if __cplusplus >= 201103L
+  const CancellationToken * cancellation_token;
+  size_t n_lines_to_check_cancellation;
+  LatencyHistogram * latency_histogram;
+#endif
+
+  /**
+   * Check cancellation token every CANCELLATION_CHECK_INTERVAL calls.
+   */
+  inline void check_cancellation() {
+#if __cplusplus >= 201103L
+    if (!cancellation_token || --n_lines_to_check_cancellation > 0) return;
+    check_cancellation_now();
+#endif
+  }
+
+  inline void check_cancellation_now() {
+#if __cplusplus >= 201103L
+    if (!cancellation_token) return;
+    n_lines_to_check_cancellation = CANCELLATION_CHECK_INTERVAL;
+    if (cancellation_token->is_cancelled()) throw PCPCancelledError("Parsing is cancelled");
+#endif
+  }
+
+  /**
+   * Find \p i-th filter pattern in [\p from, filter_window_end).
+   */
+  inline size_t find_filter_pattern(size_t i, size_t from) const {
+    if (from >= filter_window_end) return NO_HIT;
+    const char * found = _find_pattern(
+      csv_config.content() + from, filter_window_end - from, filter_patterns[i].data(), filter_patterns[i].size());
+    return found ? found - csv_config.content() : NO_HIT;
+  }
+
+  /**
+   * Same as next_line() but skips lines without any of filter_patterns.
+   */
+  inline bool next_filtered_line(/* out */ const char ** line, size_t * line_length) {
+    const char * const text = csv_config.content();
+    if (cur_pos > parse_to) return false;
+
+    if (filter_next_hits.empty()) {
+      // Lines whose beginning is in [cur_pos, parse_to] end by filter_search_end.
+      _get_current_line(text, csv_config.filesize(), parse_to, csv_config.get_line_terminator(), line, line_length);
+      filter_search_end = (*line - text) + *line_length;
+      filter_window_end = cur_pos;  // nothing searched yet
+      filter_next_hits.assign(filter_patterns.size(), size_t(NO_HIT));
+    }
+
+    while (cur_pos <= parse_to) {
+      check_cancellation();
+
+      // earliest occurrence of patterns after cur_pos
+      size_t hit = NO_HIT;
+      for (size_t i = 0; i < filter_patterns.size(); ++i) {
+        if (filter_next_hits[i] != NO_HIT && filter_next_hits[i] < cur_pos) filter_next_hits[i] = find_filter_pattern(i, cur_pos);
+        if (filter_next_hits[i] < hit) hit = filter_next_hits[i];
+      }
+      if (hit == NO_HIT) {
+        if (filter_window_end >= filter_search_end) {
+          cur_pos = parse_to + 1;
+          return false;
+        }
+        // No pattern until filter_window_end. Search the next window, overlapping the previous one by pattern length - 1.
+        check_cancellation_now();
+        const size_t prev_window_end = filter_window_end;
+        filter_window_end = std::min(std::max(cur_pos, prev_window_end) + FILTER_SEARCH_WINDOW, filter_search_end);
+        for (size_t i = 0; i < filter_patterns.size(); ++i) {
+          const size_t overlap = std::min(prev_window_end, filter_patterns[i].size() - 1);
+          filter_next_hits[i] = find_filter_pattern(i, std::max(cur_pos, prev_window_end - overlap));
+        }
+        continue;
+      }
+
+      _get_current_line(text, csv_config.filesize(), hit, csv_config.get_line_terminator(), line, line_length);
+      const size_t line_begin = *line - text;
+      if (line_begin > parse_to) {
+        cur_pos = parse_to + 1;
+        return false;
+      }
+      // Line starting before cur_pos is owned by previous parser (or already parsed).
+      //
+      // (\n or beginning of CSV file)  aaaaaaa[hit]aaaaaaa \n
+      //                                   <---...
+      //                                   cur_pos
+      const bool owned = line_begin >= cur_pos;
+      if (owned) {
+        n_terminators += _count_char(text + cur_pos, line_begin - cur_pos, csv_config.get_line_terminator());
+        last_line_n_terminators = n_terminators;
+      }
+      cur_pos = line_begin + *line_length + 1;  // +1 is from line_delimitor
+      ++n_terminators;
+      if (owned && !csv_config.is_skipped_line(*line, *line_length)) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Find the next line to parse and move cur_pos to the beginning of its next line.
+   * @return false if no line to parse remains.
+   */
+  inline bool next_line(/* out */ const char ** line, size_t * line_length) {
+    while (cur_pos <= parse_to) {
+      check_cancellation();
+      _get_current_line(csv_config.content(), csv_config.filesize(), cur_pos, csv_config.get_line_terminator(), line, line_length);
+
+      // cur_pos exactly is the beginning of current line.
+      //
+      // (\n or beginning of CSV file)  aaaaaaaaaaaaaa \n
+      //                                <----...
+      //                                cur_pos
+      //
+      // Parse "aaaaaaaaaaaaaa" and move cur_pos to the beginning of the next line.
+      if (csv_config.content() + cur_pos == *line) {
+        cur_pos += *line_length + 1;  // +1 is from line_delimitor
+        last_line_n_terminators = n_terminators++;
+        if (csv_config.is_skipped_line(*line, *line_length)) continue;
+        return true;
+      }
+
+      // parse_to is at the same line with cur_pos.
+      //
+      // (\n or beginning of CSV file)  aaaaaaaaaaaaaa \n
+      //                                    <---------->
+      //                                    cur_pos    parse_to
+      if (csv_config.content() + parse_to < *line + *line_length + 1)  // +1 is from line_delimitor
+        return false;
+
+      // parse_to is beyond the same line with cur_pos.
+      //
+      // (\n or beginning of CSV file)  aaaaaaaaaaaaaa \n bbbbbbbbbb
+      //                                    <--------------...
+      //                                    cur_pos
+      //
+      // Move cur_pos to the beginning of the next line.
+      if (csv_config.content() + parse_to >= *line + *line_length + 1) {  // +1 is from line_delimitor
+        cur_pos = (*line - csv_config.content()) + *line_length + 1;  // +1 is from line_delimitor
+        ++n_terminators;
+      }
+    }
+    return false;
+  }
+
+  PREVENT_CLASS_DEFAULT_METHODS(PartialCsvParser);
+};
+
+namespace Memory {
+
+/**
+ * Parses fixed-width records from memory, whose columns have known byte widths and no field terminators.
+ *
+ * Records are usually lines separated by a line terminator. If every line has the same length (default),
+ * or records have no terminator at all (e.g. mainframe files), record boundaries are computed arithmetically without scanning.
+ * Fixed-width records have no header line.
+ */
+class FixedWidthConfig {
+public:
+  /**
+   * Pass it as \p line_terminator for records without terminator. Records have constant length then.
+   */
+  static const char NO_LINE_TERMINATOR = '\0';
+
+  /**
+   * Constructor.
+   * @param str_length Length of \p str.
+   * @param str Records, which are not necessarily terminated with '\0'.
+   * @param widths Byte width of each column.
+   * @param line_terminator Character to separate records, or NO_LINE_TERMINATOR. For UTF-8 compatibility, only 0 ~ 127 are allowed.
+   * @param constant_line_length If true, every record has the sum of \p widths bytes (plus line terminator).
+   *   If false, lines are found by scanning line terminators, and a short line has empty (or truncated) trailing columns.
+   * @param _lazy_initialization Always set false.
+   */
+  FixedWidthConfig(
+    size_t str_length,
+    const char * const str,
+    const std::vector<size_t> & widths,
+    char line_terminator = '\n',
+    bool constant_line_length = true,
+    bool _lazy_initialization = false)
+  : widths(widths), line_terminator(line_terminator),
+    constant_line_length(constant_line_length || line_terminator == NO_LINE_TERMINATOR),
+    trim_whitespaces(false), text_size(str_length), text(str)
+  {
+    ASSERT(!widths.empty());
+    ASSERT(0 <= line_terminator); ASSERT(line_terminator <= 127);
+    ASSERT(this->constant_line_length || line_terminator != NO_LINE_TERMINATOR);
+
+    if (!_lazy_initialization) {
+      ASSERT(str_length > 0);
+      ASSERT(str);
+      init();
+    }
+  }
+
+  virtual ~FixedWidthConfig() {}
+
+  /**
+   * Return the size of records.
+   */
+  inline size_t filesize() const { return text_size; }
+
+  /**
+   * Return 0, since records have no header line. Same as CsvConfig::body_offset().
+   */
+  inline size_t body_offset() const { return 0; }
+
+  /**
+   * Return the pointer of records.
+   */
+  inline const char * const content() const { return text; }
+
+  inline size_t get_n_columns() const { return widths.size(); }
+
+  inline const std::vector<size_t> & get_widths() const { return widths; }
+
+  /**
+   * Return offset of \p i-th column from the beginning of a record.
+   */
+  inline size_t get_column_offset(size_t i) const { return column_offsets[i]; }
+
+  /**
+   * Return the sum of column widths.
+   */
+  inline size_t get_record_width() const { return record_width; }
+
+  /**
+   * Return distance between beginnings of records, including line terminator. Only meaningful with constant line length.
+   */
+  inline size_t get_record_length() const { return record_width + (line_terminator == NO_LINE_TERMINATOR ? 0 : 1); }
+
+  inline bool has_constant_line_length() const { return constant_line_length; }
+
+  /**
+   * Return the number of records, computed arithmetically. Only available with constant line length.
+   * The last record may be short, when its columns are truncated. Blank lines after the last full record are not counted.
+   */
+  inline size_t get_n_records() const {
+    ASSERT(constant_line_length);
+    return (records_end() + get_record_length() - 1) / get_record_length();
+  }
+
+  /**
+   * Return the end offset of records, excluding line terminators after the last full record (e.g. a blank line at the end of file).
+   * Only meaningful with constant line length.
+   */
+  inline size_t records_end() const {
+    size_t end = text_size;
+    if (line_terminator == NO_LINE_TERMINATOR) return end;
+    while (end % get_record_length() != 0 && text[end - 1] == line_terminator) --end;
+    return end;
+  }
+
+  inline const char get_line_terminator() const { return line_terminator; }
+
+  /**
+   * Exclude leading and trailing spaces and tabs of each column (disabled by default), which pad fixed-width columns.
+   * Same as CsvConfig::set_trim_whitespaces().
+   */
+  inline void set_trim_whitespaces(bool trim) { trim_whitespaces = trim; }
+
+  inline bool get_trim_whitespaces() const { return trim_whitespaces; }
+
+protected:
+  const std::vector<size_t> widths;
+  const char line_terminator;
+  const bool constant_line_length;
+  bool trim_whitespaces;
+
+  size_t text_size;
+  const char * text;
+
+  std::vector<size_t> column_offsets;
+  size_t record_width;
+
+  inline void init() {
+    column_offsets.resize(widths.size());
+    record_width = 0;
+    for (size_t i = 0; i < widths.size(); ++i) {
+      column_offsets[i] = record_width;
+      record_width += widths[i];
+    }
+    ASSERT(get_record_length() > 0);
+  }
+
+private:
+  PREVENT_CLASS_DEFAULT_METHODS(FixedWidthConfig);
+};
+
+}
+
+
+/**
+ * Parses fixed-width records file.
+ */
+class FixedWidthConfig : public Memory::FixedWidthConfig {
+public:
+  /**
+   * Constructor.
+   * @param filepath Path to file to read.
+   * Other parameters are the same as Memory::FixedWidthConfig::FixedWidthConfig().
+   */
+  FixedWidthConfig(
+    const char * const filepath,
+    const std::vector<size_t> & widths,
+    char line_terminator = '\n',
+    bool constant_line_length = true)
+  THROWS(PCPError)
+  : Memory::FixedWidthConfig(0, NULL, widths, line_terminator, constant_line_length, true)
+  {
+    if ((fd = open(filepath, O_RDONLY)) == -1)
+      STRERROR_THROW(PCPError, std::string("while open ") + filepath);
+    text_size = _filesize(fd);
+    if ((text = static_cast<const char *>(mmap(NULL, text_size, PROT_READ, MAP_PRIVATE, fd, 0))) == (void*)-1)
+      STRERROR_THROW(PCPError, std::string("while mmap ") + filepath);
+    // prefetch pages from disk to avoid random accesses from threads.
+    if (madvise((void*)text, text_size, MADV_WILLNEED) == -1)
+      STRERROR_THROW(PCPError, std::string("while madvise ") + filepath);
+
+    init();
+  }
+
+  ~FixedWidthConfig() {
+    if (munmap((void*)text, text_size) != 0) PERROR_ABORT("while munmap");
+    if (close(fd) != 0) PERROR_ABORT("while closing file descriptor");
+  }
+
+private:
+  int fd;
+
+  PREVENT_CLASS_DEFAULT_METHODS(FixedWidthConfig);
+};
+
+
+/**
+ * Parser to cut fixed-width records into columns by widths.
+ *
+ * Like PartialCsvParser, the parser whose range covers the beginning of a record parses the record,
+ * so parsers with adjacent ranges parse every record exactly once.
+ * With constant line length, the first and last records in range are computed arithmetically.
+ */
+class PartialFixedWidthParser {
+public:
+  /**
+   * Constructor.
+   * @param config Instance of Memory::FixedWidthConfig or its child class.
+   * @param parse_from <em>Approximate</em> offset to start parsing.
+   * @param parse_to <em>Approximate</em> offset to stop parsing. Must be no less than \p parse_from and less than FixedWidthConfig::filesize().
+   *   \p parse_to = PARSE_TO_FILE_END has the same meaning with \p parse_to = FixedWidthConfig::filesize() - 1.
+   */
+  PartialFixedWidthParser(
+    const Memory::FixedWidthConfig & config,
+    size_t parse_from = 0,
+    size_t parse_to = PARSE_TO_FILE_END)
+  : config(config), parse_to(parse_to)
+  {
+    if (parse_to == PARSE_TO_FILE_END) this->parse_to = config.filesize() - 1;
+    ASSERT(this->parse_to < config.filesize());
+
+    if (config.has_constant_line_length()) {
+      // first record beginning at or after parse_from
+      const size_t record_length = config.get_record_length();
+      cur_pos = (parse_from + record_length - 1) / record_length * record_length;
+    }
+    else {
+      cur_pos = _line_beginning_from(config.content(), config.filesize(), parse_from, config.get_line_terminator());
+    }
+  }
+
+  ~PartialFixedWidthParser() {}
+
+  /**
+   * Returns an array of columns of the next record.
+   * @return Array of columns if record to parse remains. Otherwise, empty vector is returned. Check by \p retval.empty().
+   * @throw PCPCsvError With constant line length, a record is not followed by line terminator.
+   */
+  inline std::vector<std::string> get_row() THROWS(PCPCsvError) {
+    std::vector<std::string> row;
+    get_row(row);
+    return row;
+  }
+
+  /**
+   * Set columns of the next record to \p row. Same as PartialCsvParser::get_row(Row &).
+   * @param[out] row Container of strings. Cleared if no record to parse remains.
+   * @return true if a record is parsed. Otherwise, false.
+   * @throw PCPCsvError With constant line length, a record is not followed by line terminator (the line is shorter or longer than the record width),
+   *   or the last record is truncated by a line terminator. PCPCsvError::get_line_number() is the 1-origin record number in the file.
+   */
+  template <class Row>
+  inline bool get_row(/* out */ Row & row) THROWS(PCPCsvError) {
+    const char * record;
+    size_t record_length;
+    if (!next_record(&record, &record_length)) {
+      row.clear();
+      return false;
+    }
+
+    const size_t n_columns = config.get_n_columns();
+    const bool trim_whitespaces = config.get_trim_whitespaces();
+    row.resize(n_columns);
+    for (size_t i = 0; i < n_columns; ++i) {
+      const size_t offset = std::min(config.get_column_offset(i), record_length);
+      const char * const column = record + offset;
+      _set_column(row, i, column, column + std::min(config.get_widths()[i], record_length - offset), trim_whitespaces);
+    }
+    return true;
+  }
+
+private:
+  static const size_t PARSE_TO_FILE_END = -1;
+
+  const Memory::FixedWidthConfig & config;
+  size_t parse_to;
+  size_t cur_pos;  // beginning of the next record
+
+  /**
+   * Find the next record to parse and move cur_pos to the beginning of its next record.
+   * @return false if no record to parse remains.
+   */
+  inline bool next_record(/* out */ const char ** record, size_t * record_length) THROWS(PCPCsvError) {
+    if (cur_pos > parse_to || cur_pos >= config.filesize()) return false;
+    *record = config.content() + cur_pos;
+
+    if (config.has_constant_line_length()) {
+      // line terminators after the last full record are a blank tail, not a record
+      if (cur_pos >= config.records_end()) return false;
+      *record_length = std::min(config.get_record_width(), config.filesize() - cur_pos);
+      // a malformed line would shift all following records, so check the terminator of each record (one byte).
+      if (config.get_line_terminator() != Memory::FixedWidthConfig::NO_LINE_TERMINATOR &&
+          (cur_pos + config.get_record_width() < config.filesize() ?
+           (*record)[config.get_record_width()] != config.get_line_terminator() :
+           std::memchr(*record, config.get_line_terminator(), *record_length) != NULL)) {
+        const size_t record_number = cur_pos / config.get_record_length() + 1;
+        std::ostringstream ss;
+        ss << "Record " << record_number << " is not terminated by line terminator at its width " << config.get_record_width() << "." << std::endl
+           << std::string(*record, *record_length);
+        throw PCPCsvError(ss.str(), record_number);
+      }
+      cur_pos += config.get_record_length();
+      return true;
+    }
+
+    const char * line_end = static_cast<const char *>(std::memchr(*record, config.get_line_terminator(), config.filesize() - cur_pos));
+    *record_length = line_end ? line_end - *record : config.filesize() - cur_pos;
+    cur_pos += *record_length + 1;  // +1 is from line_delimitor
+    return true;
+  }
+
+  PREVENT_CLASS_DEFAULT_METHODS(PartialFixedWidthParser);
+};
+
+
+/**
+ * Find the first '"' or '\\' in [\p p, \p end), which ends a run of plain bytes in a JSON string.
+ * 8 bytes are compared at once (SWAR).
+ * @return Pointer to the found byte, or \p end if not found.
+ */
+inline const char * _find_json_string_special(const char * p, const char * const end) {
+  const unsigned long long QUOTES = _swar_broadcast('"'), BACKSLASHES = _swar_broadcast('\\');
+  for (; end - p >= static_cast<ptrdiff_t>(sizeof(unsigned long long)); p += sizeof(unsigned long long)) {
+    unsigned long long word;
+    std::memcpy(&word, p, sizeof(word));
+    if (_swar_match(word, QUOTES) | _swar_match(word, BACKSLASHES)) break;  // found in these 8 bytes
+  }
+  for (; p < end; ++p) if (*p == '"' || *p == '\\') return p;
+  return end;
+}
+
+/**
+ * Find the first '"', '[', ']', '{' or '}' in [\p p, \p end), which changes nesting of a JSON value.
+ * 8 bytes are compared at once (SWAR). Brackets are found by 2 comparisons since ('[' | 0x20) == '{' and (']' | 0x20) == '}'.
+ * @return Pointer to the found byte, or \p end if not found.
+ */
+inline const char * _find_json_structural(const char * p, const char * const end) {
+  const unsigned long long QUOTES = _swar_broadcast('"'), OPENS = _swar_broadcast('{'), CLOSES = _swar_broadcast('}'), CASES = _swar_broadcast(0x20);
+  for (; end - p >= static_cast<ptrdiff_t>(sizeof(unsigned long long)); p += sizeof(unsigned long long)) {
+    unsigned long long word;
+    std::memcpy(&word, p, sizeof(word));
+    if (_swar_match(word, QUOTES) | _swar_match(word | CASES, OPENS) | _swar_match(word | CASES, CLOSES)) break;
+  }
+  for (; p < end; ++p) if (*p == '"' || (*p | 0x20) == '{' || (*p | 0x20) == '}') return p;
+  return end;
+}
+
+inline const char * _skip_json_whitespaces(const char * p, const char * const end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+  return p;
+}
+
+/**
+ * Skip a JSON string beginning at \p p, which points at the opening '"'.
+ * @return Pointer next to the closing '"', or NULL if the string is not closed.
+ */
+inline const char * _skip_json_string(const char * p, const char * const end) {
+  ASSERT(*p == '"');
+  for (++p; (p = _find_json_string_special(p, end)) < end; p += 2) {
+    if (*p == '"') return p + 1;
+  }
+  return NULL;
+}
+
+/**
+ * Skip a JSON value beginning at \p p without validating it.
+ * Strings and nested objects / arrays are skipped by structural characters. Other values (numbers, true, false and null) end at ',', '}', ']' or a whitespace.
+ * @return Pointer next to the value, or NULL if the value is not closed.
+ */
+inline const char * _skip_json_value(const char * p, const char * const end) {
+  if (p >= end) return NULL;
+  if (*p == '"') return _skip_json_string(p, end);
+  if (*p == '{' || *p == '[') {
+    size_t depth = 0;
+    while ((p = _find_json_structural(p, end)) < end) {
+      if (*p == '"') {
+        if (!(p = _skip_json_string(p, end))) return NULL;
+        continue;
+      }
+      if ((*p | 0x20) == '{') ++depth;
+      else if (--depth == 0) return p + 1;
+      ++p;
+    }
+    return NULL;
+  }
+  const char * const begin = p;
+  while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') ++p;
+  return p == begin ? NULL : p;
+}
+
+/**
+ * Append UTF-8 bytes of \p code_point to \p str.
+ */
+template <class String>
+inline void _append_utf8(/* out */ String & str, unsigned long code_point) {
+  if (code_point < 0x80) {
+    str.push_back(static_cast<char>(code_point));
+  }
+  else if (code_point < 0x800) {
+    str.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+    str.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+  else if (code_point < 0x10000) {
+    str.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+    str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    str.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+  else {
+    str.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+    str.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+    str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    str.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+/**
+ * Parse 4 hex digits of \uXXXX escape at \p p.
+ * @return false if \p p does not have 4 hex digits.
+ */
+inline bool _parse_json_hex4(const char * p, const char * const end, /* out */ unsigned long * value) {
+  if (end - p < 4) return false;
+  *value = 0;
+  for (size_t i = 0; i < 4; ++i, ++p) {
+    const char c = *p;
+    unsigned long digit;
+    if ('0' <= c && c <= '9') digit = c - '0';
+    else if ('a' <= (c | 0x20) && (c | 0x20) <= 'f') digit = (c | 0x20) - 'a' + 10;
+    else return false;
+    *value = *value * 16 + digit;
+  }
+  return true;
+}
+
+/**
+ * Set contents of JSON string [\p str, \p str + \p len) (without quotes) to \p i-th column of \p row, decoding escape sequences.
+ * Runs of plain bytes are copied at once, so a string without escape sequences is copied like _set_column().
+ * @return false if an escape sequence is invalid.
+ */
+template <class Row>
+inline bool _set_json_string_column(Row & row, size_t i, const char * str, size_t len) {
+  const char * const end = str + len;
+  const char * p = _find_json_string_special(str, end);
+  _set_column(row, i, str, p - str);
+  while (p < end) {
+    ASSERT(*p == '\\');
+    if (++p == end) return false;
+    switch (*p++) {
+      case '"': row[i].push_back('"'); break;
+      case '\\': row[i].push_back('\\'); break;
+      case '/': row[i].push_back('/'); break;
+      case 'b': row[i].push_back('\b'); break;
+      case 'f': row[i].push_back('\f'); break;
+      case 'n': row[i].push_back('\n'); break;
+      case 'r': row[i].push_back('\r'); break;
+      case 't': row[i].push_back('\t'); break;
+      case 'u': {
+        unsigned long code_point, low;
+        if (!_parse_json_hex4(p, end, &code_point)) return false;
+        p += 4;
+        // surrogate pair
+        if (0xd800 <= code_point && code_point < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+            _parse_json_hex4(p + 2, end, &low) && 0xdc00 <= low && low < 0xe000) {
+          code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+          p += 6;
+        }
+        _append_utf8(row[i], code_point);
+        break;
+      }
+      default: return false;
+    }
+    const char * const run_end = _find_json_string_special(p, end);
+    row[i].append(p, run_end - p);
+    p = run_end;
+  }
+  return true;
+}
+
+
+namespace Memory {
+
+/**
+ * Parses NDJSON (JSON Lines) from memory, each of whose lines is a JSON object.
+ *
+ * Values of requested top-level keys are extracted as columns, so that NDJSON is parsed into the same rows as CSV.
+ * Lines never contain a raw line terminator (it is escaped in JSON strings), so ranges of a file are split by lines like CSV.
+ * NDJSON has no header line; keys work as headers.
+ */
+class NdjsonConfig {
+public:
+  /**
+   * Constructor.
+   * @param str_length Length of \p str.
+   * @param str NDJSON, which is not necessarily terminated with '\0'.
+   * @param keys Top-level keys to extract as columns, in order of columns.
+   * @param line_terminator Character to separate lines. For UTF-8 compatibility, only 0 ~ 127 are allowed.
+   * @param _lazy_initialization Always set false.
+   */
+  NdjsonConfig(
+    size_t str_length,
+    const char * const str,
+    const std::vector<std::string> & keys,
+    char line_terminator = '\n',
+    bool _lazy_initialization = false)
+  : keys(keys), line_terminator(line_terminator), text_size(str_length), text(str)
+  {
+    ASSERT(!keys.empty());
+    ASSERT(0 <= line_terminator); ASSERT(line_terminator <= 127);
+
+    if (!_lazy_initialization) {
+      ASSERT(str_length > 0);
+      ASSERT(str);
+    }
+  }
+
+  virtual ~NdjsonConfig() {}
+
+  /**
+   * Return the size of NDJSON.
+   */
+  inline size_t filesize() const { return text_size; }
+
+  /**
+   * Return 0, since NDJSON lines have no header line. Same as CsvConfig::body_offset().
+   */
+  inline size_t body_offset() const { return 0; }
+
+  /**
+   * Return the pointer of NDJSON.
+   */
+  inline const char * const content() const { return text; }
+
+  inline size_t get_n_columns() const { return keys.size(); }
+
+  /**
+   * Return keys extracted as columns, which are used like headers of CSV.
+   */
+  inline const std::vector<std::string> & get_keys() const { return keys; }
+
+  inline const char get_line_terminator() const { return line_terminator; }
+
+protected:
+  const std::vector<std::string> keys;
+  const char line_terminator;
+
+  size_t text_size;
+  const char * text;
+
+private:
+  PREVENT_CLASS_DEFAULT_METHODS(NdjsonConfig);
+};
+
+}
+
+
+/**
+ * Parses NDJSON (JSON Lines) file.
+ */
+class NdjsonConfig : public Memory::NdjsonConfig {
+public:
+  /**
+   * Constructor.
+   * @param filepath Path to file to read.
+   * Other parameters are the same as Memory::NdjsonConfig::NdjsonConfig().
+   */
+  NdjsonConfig(
+    const char * const filepath,
+    const std::vector<std::string> & keys,
+    char line_terminator = '\n')
+  THROWS(PCPError)
+  : Memory::NdjsonConfig(0, NULL, keys, line_terminator, true)
+  {
+    if ((fd = open(filepath, O_RDONLY)) == -1)
+      STRERROR_THROW(PCPError, std::string("while open ") + filepath);
+    text_size = _filesize(fd);
+    if ((text = static_cast<const char *>(mmap(NULL, text_size, PROT_READ, MAP_PRIVATE, fd, 0))) == (void*)-1)
+      STRERROR_THROW(PCPError, std::string("while mmap ") + filepath);
+    // prefetch pages from disk to avoid random accesses from threads.
+    if (madvise((void*)text, text_size, MADV_WILLNEED) == -1)
+      STRERROR_THROW(PCPError, std::string("while madvise ") + filepath);
+  }
+
+  ~NdjsonConfig() {
+    if (munmap((void*)text, text_size) != 0) PERROR_ABORT("while munmap");
+    if (close(fd) != 0) PERROR_ABORT("while closing file descriptor");
+  }
+
+private:
+  int fd;
+
+  PREVENT_CLASS_DEFAULT_METHODS(NdjsonConfig);
+};
+
+
+/**
+ * Parser to extract values of top-level keys from NDJSON lines.
+ *
+ * Like PartialCsvParser, the parser whose range covers the beginning of a line parses the line,
+ * so parsers with adjacent ranges parse every line exactly once.
+ *
+ * Each line is scanned only at top level: strings and nested values are skipped by structural characters found 8 bytes at once,
+ * and scanning stops as soon as all keys are found.
+ * Columns are
+ * @li contents of strings with escape sequences decoded,
+ * @li raw text of other values (numbers, true, false, null, objects and arrays),
+ * @li empty for missing keys.
+ *
+ * Keys are compared with raw bytes of JSON keys, so a key written with escape sequences does not match.
+ * If a key appears twice in a line, its first value is taken.
+ * Blank lines are skipped.
+ */
+class PartialNdjsonParser {
+public:
+  /**
+   * Constructor.
+   * @param config Instance of Memory::NdjsonConfig or its child class.
+   * @param parse_from <em>Approximate</em> offset to start parsing.
+   * @param parse_to <em>Approximate</em> offset to stop parsing. Must be no less than \p parse_from and less than NdjsonConfig::filesize().
+   *   \p parse_to = PARSE_TO_FILE_END has the same meaning with \p parse_to = NdjsonConfig::filesize() - 1.
+   */
+  PartialNdjsonParser(
+    const Memory::NdjsonConfig & config,
+    size_t parse_from = 0,
+    size_t parse_to = PARSE_TO_FILE_END)
+  : config(config), parse_to(parse_to), n_lines(0), found(config.get_n_columns())
+  {
+    if (parse_to == PARSE_TO_FILE_END) this->parse_to = config.filesize() - 1;
+    ASSERT(this->parse_to < config.filesize());
+    cur_pos = _line_beginning_from(config.content(), config.filesize(), parse_from, config.get_line_terminator());
+    range_begin = cur_pos;
+  }
+
+  ~PartialNdjsonParser() {}
+
+  /**
+   * Returns an array of values of keys in the next line.
+   * @return Array of columns if line to parse remains. Otherwise, empty vector is returned. Check by \p retval.empty().
+   * @throw PCPCsvError A line is not a JSON object.
+   */
+  inline std::vector<std::string> get_row() THROWS(PCPCsvError) {
+    std::vector<std::string> row;
+    get_row(row);
+    return row;
+  }
+
+  /**
+   * Set values of keys in the next line to \p row. Same as PartialCsvParser::get_row(Row &).
+   * @param[out] row Container of strings. Cleared if no line to parse remains.
+   * @return true if a line is parsed. Otherwise, false.
+   * @throw PCPCsvError A line is not a JSON object.
+   */
+  template <class Row>
+  inline bool get_row(/* out */ Row & row) THROWS(PCPCsvError) {
+    const char * line;
+    size_t line_length;
+    if (!next_line(&line, &line_length)) {
+      row.clear();
+      return false;
+    }
+    if (!parse_line(line, line + line_length, row)) {
+      // Lines before the range are counted only on error so that get_row() stays O(line length).
+      const size_t line_number = _count_char(config.content(), range_begin, config.get_line_terminator()) + n_lines;
+      std::ostringstream ss;
+      ss << "The following line (line " << line_number << ") is not a JSON object." << std::endl << std::string(line, line_length);
+      throw PCPCsvError(ss.str(), line_number);
+    }
+    return true;
+  }
+
+private:
+  static const size_t PARSE_TO_FILE_END = -1;
+
+  const Memory::NdjsonConfig & config;
+  size_t parse_to;
+  size_t range_begin;  // beginning of the first line this parser owns
+  size_t cur_pos;  // beginning of the next line
+  size_t n_lines;  // number of lines in [range_begin, cur_pos)
+  std::vector<char> found;  // whether each key is found in current line
+
+  /**
+   * Find the next non-blank line to parse and move cur_pos to the beginning of its next line.
+   * @return false if no line to parse remains.
+   */
+  inline bool next_line(/* out */ const char ** line, size_t * line_length) {
+    while (cur_pos <= parse_to && cur_pos < config.filesize()) {
+      *line = config.content() + cur_pos;
+      const char * line_end = static_cast<const char *>(std::memchr(*line, config.get_line_terminator(), config.filesize() - cur_pos));
+      *line_length = line_end ? line_end - *line : config.filesize() - cur_pos;
+      cur_pos += *line_length + 1;  // +1 is from line_delimitor
+      ++n_lines;
+      if (_skip_json_whitespaces(*line, *line + *line_length) < *line + *line_length) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Set values of keys in JSON object [\p p, \p end) to \p row.
+   * @return false if the line is not a JSON object.
+   */
+  template <class Row>
+  inline bool parse_line(const char * p, const char * const end, /* out */ Row & row) {
+    const std::vector<std::string> & keys = config.get_keys();
+    row.resize(keys.size());
+    std::fill(found.begin(), found.end(), 0);
+    size_t n_found = 0;
+
+    p = _skip_json_whitespaces(p, end);
+    if (p == end || *p != '{') return false;
+    p = _skip_json_whitespaces(p + 1, end);
+    if (p < end && *p == '}') p = end;  // empty object
+
+    while (p < end && n_found < keys.size()) {
+      // key
+      if (*p != '"') return false;
+      const char * const key = p + 1;
+      if (!(p = _skip_json_string(p, end))) return false;
+      const size_t key_length = p - 1 - key;
+
+      p = _skip_json_whitespaces(p, end);
+      if (p == end || *p != ':') return false;
+      const char * const value = _skip_json_whitespaces(p + 1, end);
+      if (!(p = _skip_json_value(value, end))) return false;
+
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (found[i] || keys[i].size() != key_length || std::memcmp(keys[i].data(), key, key_length) != 0) continue;
+        if (*value == '"') {
+          if (!_set_json_string_column(row, i, value + 1, p - 1 - (value + 1))) return false;
+        }
+        else {
+          _set_column(row, i, value, p - value);
+        }
+        found[i] = 1;
+        ++n_found;
+        break;
+      }
+
+      p = _skip_json_whitespaces(p, end);
+      if (p == end) return false;
+      if (*p == '}') break;
+      if (*p != ',') return false;
+      p = _skip_json_whitespaces(p + 1, end);
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i) if (!found[i]) _set_column(row, i, "", 0);
+    return true;
+  }
+
+  PREVENT_CLASS_DEFAULT_METHODS(PartialNdjsonParser);
+};
+
+
+
+#if __cplusplus >= 201103L
+
+/**
+ * Progress of a worker thread in ParallelCsvParser.
+ */
+typedef struct worker_progress_t {
+  size_t bytes_consumed;  ///< Byte length of chunks finished by the worker.
+  size_t rows;  ///< Number of rows processed by the worker.
+  size_t current_offset;  ///< Offset of the chunk the worker is parsing.
+  size_t lag_bytes;  ///< How far current_offset is behind the most advanced worker's.
+} worker_progress_t;
+
+/**
+ * Snapshot of progress of ParallelCsvParser. See ParallelCsvParser::get_progress().
+ */
+typedef struct progress_t {
+  size_t total_bytes;  ///< Byte length of CSV body.
+  size_t bytes_consumed;  ///< Byte length of chunks finished.
+  size_t rows;  ///< Number of rows processed (passed to visitor, accepted, or validated).
+  double elapsed_sec;  ///< Seconds since parsing started.
+  double bytes_per_sec;  ///< Average throughput since parsing started.
+  double eta_sec;  ///< Estimated seconds to finish. Negative if unknown.
+  bool finished;  ///< True after parsing finished.
+  std::vector<worker_progress_t> workers;
+} progress_t;
+
+/**
+ * Records timeline of worker threads of ParallelCsvParser and exports it as
+ * <a href="https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU">Chrome trace event format</a>,
+ * which can be viewed by chrome://tracing or <a href="https://ui.perfetto.dev">Perfetto</a>.
+ *
+ * Each worker records events to its own ring buffer of fixed capacity, so tracing never allocates nor contends while parsing.
+ * The oldest events are overwritten when a ring buffer is full.
+ */
+class Tracer {
+public:
+  typedef std::chrono::steady_clock clock;
+
+  static const size_t MAX_ARGS = 8;
+  static const size_t DEFAULT_CAPACITY_PER_THREAD = 64 * 1024;
+
+  /**
+   * Span of an activity of a thread.
+   */
+  typedef struct event_t {
+    const char * name;  ///< Must be a static string without characters to escape in JSON.
+    double start_us;  ///< Microseconds since the Tracer is constructed.
+    double duration_us;
+    size_t n_args;
+    const char * arg_names[MAX_ARGS];
+    double arg_values[MAX_ARGS];
+
+    inline void add_arg(const char * arg_name, double value) {
+      if (n_args == MAX_ARGS) return;
+      arg_names[n_args] = arg_name;
+      arg_values[n_args++] = value;
+    }
+  } event_t;
+
+  /**
+   * Constructor.
+   * @param capacity_per_thread Number of events kept for each thread.
+   */
+  explicit Tracer(size_t capacity_per_thread = DEFAULT_CAPACITY_PER_THREAD)
+  : capacity(capacity_per_thread), epoch(clock::now())
+  {
+    ASSERT(capacity >= 1);
+  }
+
+  /**
+   * Prepare ring buffers for threads 0 ~ \p n_threads - 1. Not thread-safe. Called before workers start.
+   */
+  inline void reserve_threads(size_t n_threads) {
+    if (rings.size() < n_threads) rings.resize(n_threads, ring_t(capacity));
+  }
+
+  /**
+   * Start an event.
+   */
+  inline event_t begin(const char * name) const {
+    event_t event;
+    event.name = name;
+    event.start_us = now_us();
+    event.duration_us = 0;
+    event.n_args = 0;
+    return event;
+  }
+
+  /**
+   * Finish an event started by begin() and record it to the ring buffer of thread \p tid.
+   * Only thread \p tid may call it.
+   */
+  inline void end(size_t tid, event_t & event) {
+    event.duration_us = now_us() - event.start_us;
+    ring_t & ring = rings[tid];
+    ring.events[ring.n_recorded++ % capacity] = event;
+  }
+
+  /**
+   * Return the number of events overwritten in ring buffers.
+   */
+  inline size_t get_n_dropped() const {
+    size_t n_dropped = 0;
+    for (size_t i = 0; i < rings.size(); ++i)
+      if (rings[i].n_recorded > capacity) n_dropped += rings[i].n_recorded - capacity;
+    return n_dropped;
+  }
+
+  /**
+   * Discard recorded events.
+   */
+  inline void clear() {
+    for (size_t i = 0; i < rings.size(); ++i) rings[i].n_recorded = 0;
+  }
+
+  /**
+   * Write recorded events in Chrome trace event format (JSON). Call it after parsing finished.
+   */
+  inline void write_chrome_trace(std::ostream & os) const {
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "{\"traceEvents\":[";
+    bool first = true;
+    for (size_t tid = 0; tid < rings.size(); ++tid) {
+      ss << (first ? "" : ",") << std::endl
+         << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"worker " << tid << "\"}}";
+      first = false;
+
+      const ring_t & ring = rings[tid];
+      const size_t n_events = std::min(ring.n_recorded, capacity);
+      for (size_t i = ring.n_recorded - n_events; i < ring.n_recorded; ++i) {
+        const event_t & event = ring.events[i % capacity];
+        ss << "," << std::endl
+           << "{\"name\":\"" << event.name << "\",\"cat\":\"PartialCsvParser\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+           << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << ",\"args\":{";
+        for (size_t j = 0; j < event.n_args; ++j)
+          ss << (j == 0 ? "" : ",") << "\"" << event.arg_names[j] << "\":" << event.arg_values[j];
+        ss << "}}";
+      }
+    }
+    ss << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    os << ss.str();
+  }
+
+private:
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  struct ring_t {
+    std::vector<event_t> events;
+    size_t n_recorded;
+    char padding[CACHE_LINE_SIZE];  // written by different threads
+
+    explicit ring_t(size_t capacity) : events(capacity), n_recorded(0) {}
+  };
+
+  const size_t capacity;
+  const clock::time_point epoch;
+  std::vector<ring_t> rings;
+
+  inline double now_us() const { return std::chrono::duration<double, std::micro>(clock::now() - epoch).count(); }
+
+  PREVENT_COPY_CONSTRUCTOR(Tracer);
+  PREVENT_OBJECT_ASSIGNMENT(Tracer);
+};
+
+/**
+ * Return the numbers of major and minor page faults of calling thread. -1 if not available.
+ */
+inline void _thread_page_faults(/* out */ long * n_major_faults, long * n_minor_faults) {
+  *n_major_faults = *n_minor_faults = -1;
+#ifdef RUSAGE_THREAD
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+    *n_major_faults = usage.ru_majflt;
+    *n_minor_faults = usage.ru_minflt;
+  }
+#endif
+}
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue (Vyukov's array-based queue with per-cell sequence numbers).
+ * Producers and consumers never take locks; blocking push() / pop() spin with backoff while the queue is full / empty,
+ * which gives backpressure between pipeline stages. Also serves as an SPSC queue.
+ * @tparam T Copyable value, e.g. a pointer to a batch.
+ */
+template <class T>
+class BoundedQueue {
+public:
+  /**
+   * @param capacity Maximum number of values, rounded up to a power of 2.
+   */
+  explicit BoundedQueue(size_t capacity)
+  : capacity(_round_up_pow2(std::max(capacity, size_t(2)))), cells(new cell_t[this->capacity]), closed(false)
+  {
+    for (size_t i = 0; i < this->capacity; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    enqueue_pos.value.store(0, std::memory_order_relaxed);
+    dequeue_pos.value.store(0, std::memory_order_relaxed);
+  }
+
+  inline size_t get_capacity() const { return capacity; }
+
+  /**
+   * Push \p value unless the queue is full. Thread-safe.
+   */
+  inline bool try_push(const T & value) {
+    size_t pos = enqueue_pos.value.load(std::memory_order_relaxed);
+    cell_t * cell;
+    while (true) {
+      cell = &cells[pos & (capacity - 1)];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0) return false;  // full
+      else pos = enqueue_pos.value.load(std::memory_order_relaxed);
+    }
+    cell->value = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Pop the oldest value to \p value unless the queue is empty. Thread-safe.
+   */
+  inline bool try_pop(/* out */ T & value) {
+    size_t pos = dequeue_pos.value.load(std::memory_order_relaxed);
+    cell_t * cell;
+    while (true) {
+      cell = &cells[pos & (capacity - 1)];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0) return false;  // empty
+      else pos = dequeue_pos.value.load(std::memory_order_relaxed);
+    }
+    value = cell->value;
+    cell->sequence.store(pos + capacity, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Push \p value, waiting while the queue is full.
+   * @return false if the queue is closed, when \p value is not pushed.
+   */
+  inline bool push(const T & value) {
+    for (size_t n_tries = 0; !is_closed(); ++n_tries) {
+      if (try_push(value)) return true;
+      _backoff(n_tries);
+    }
+    return false;
+  }
+
+  /**
+   * Pop the oldest value to \p value, waiting while the queue is empty.
+   * @return false if the queue is closed and empty.
+   */
+  inline bool pop(/* out */ T & value) {
+    for (size_t n_tries = 0; ; ++n_tries) {
+      if (try_pop(value)) return true;
+      if (is_closed()) return try_pop(value);  // values pushed before close() are still popped
+      _backoff(n_tries);
+    }
+  }
+
+  /**
+   * Let push() fail, and pop() fail after the queue becomes empty. Thread-safe.
+   */
+  inline void close() { closed.store(true, std::memory_order_release); }
+
+  inline bool is_closed() const { return closed.load(std::memory_order_acquire); }
+
+private:
+  typedef struct cell_t {
+    std::atomic<size_t> sequence;
+    T value;
+  } cell_t;
+
+  // position counters on their own cache lines, since producers and consumers update them
+  typedef struct padded_position_t {
+    char padding_before[64];
+    std::atomic<size_t> value;
+    char padding_after[64];
+  } padded_position_t;
+
+  const size_t capacity;
+  std::unique_ptr<cell_t[]> cells;
+  padded_position_t enqueue_pos, dequeue_pos;
+  std::atomic<bool> closed;
+
+  static inline size_t _round_up_pow2(size_t n) {
+    size_t pow2 = 1;
+    while (pow2 < n) pow2 <<= 1;
+    return pow2;
+  }
+
+  // spin, then yield, then sleep, so that a slow stage does not burn CPUs of waiting stages
+  static inline void _backoff(size_t n_tries) {
+    if (n_tries < 64) return;
+    if (n_tries < 128) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  PREVENT_CLASS_DEFAULT_METHODS(BoundedQueue);
+};
+
+/**
+ * Per-job throttles of ParallelCsvParser, so that background parses soak up idle capacity without starving foreground work.
+ *
+ * - Maximum number of workers: workers with larger index wait before taking chunks.
+ * - Read budget in bytes/sec: workers wait before parsing chunks taken beyond the budget.
+ * - Pause and resume: workers wait before taking chunks while paused. Chunks already taken are finished.
+ *
+ * All controls are thread-safe and take effect while parsing. Waiting workers wake up on cancellation.
+ * Parsers sharing a governor share its read budget.
+ * Note that waiting workers block their threads, including workers of Executor.
+ */
+class ResourceGovernor {
+public:
+  typedef std::chrono::steady_clock clock;
+
+  /**
+   * Value of max workers and bytes/sec for no limit.
+   */
+  static const size_t UNLIMITED = 0;
+
+  ResourceGovernor()
+  : max_workers(UNLIMITED), bytes_per_sec(UNLIMITED), paused(false), next_budget_time(clock::now())
+  {}
+
+  /**
+   * Let only workers 0 to \p max_workers - 1 take chunks. UNLIMITED by default.
+   */
+  inline void set_max_workers(size_t max_workers) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->max_workers = max_workers;
+    cond.notify_all();
+  }
+
+  /**
+   * Limit bytes of chunks parsed per second. UNLIMITED by default.
+   */
+  inline void set_bytes_per_sec(size_t bytes_per_sec) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->bytes_per_sec = bytes_per_sec;
+    next_budget_time = clock::now();
+    cond.notify_all();
+  }
+
+  /**
+   * Stop workers from taking chunks until resume().
+   */
+  inline void pause() {
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = true;
+  }
+
+  inline void resume() {
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = false;
+    cond.notify_all();
+  }
+
+  inline bool is_paused() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return paused;
+  }
+
+  inline size_t get_max_workers() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_workers;
+  }
+
+  inline size_t get_bytes_per_sec() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes_per_sec;
+  }
+
+private:
+  friend class ParallelCsvParser;
+
+  // interval to check \p stopped while waiting, since cancellation has no notification
+  enum { POLL_INTERVAL_MS = 10 };
+
+  size_t max_workers, bytes_per_sec;
+  bool paused;
+  clock::time_point next_budget_time;  // when budget for the next bytes becomes available
+  mutable std::mutex mutex;
+  std::condition_variable cond;
+
+  /**
+   * Wait until worker \p i_worker may take chunks, or \p stopped() returns true.
+   */
+  template <class StopPredicate>
+  inline void wait_for_turn(size_t i_worker, StopPredicate stopped) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while ((paused || (max_workers != UNLIMITED && i_worker >= max_workers)) && !stopped())
+      cond.wait_for(lock, std::chrono::milliseconds(POLL_INTERVAL_MS));
+  }
+
+  /**
+   * Take budget for \p n_bytes, and wait until the budget becomes available or \p stopped() returns true.
+   * Budget is given in order of requests, each request starting when the previous requests have been paid for,
+   * so a chunk larger than budget per second is not starved.
+   */
+  template <class StopPredicate>
+  inline void consume(size_t n_bytes, StopPredicate stopped) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (bytes_per_sec == UNLIMITED) return;
+    const clock::time_point now = clock::now();
+    if (next_budget_time < now) next_budget_time = now;
+    const clock::time_point start = next_budget_time;
+    next_budget_time += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(double(n_bytes) / bytes_per_sec));
+
+    while (clock::now() < start && !stopped())
+      cond.wait_until(lock, std::min(start, clock::now() + std::chrono::milliseconds(POLL_INTERVAL_MS)));
+  }
+
+  PREVENT_COPY_CONSTRUCTOR(ResourceGovernor);
+  PREVENT_OBJECT_ASSIGNMENT(ResourceGovernor);
+};
+
+/**
+ * Pool of persistent worker threads shared by parse jobs, to bound the number of threads however many jobs run concurrently.
+ *
+ * Tasks are submitted to a Job. Workers serve jobs with the highest priority first,
+ * and jobs with the same priority in round-robin, one task at a time.
+ * So each job gets a fair share of workers as long as its tasks are small (e.g. a chunk).
+ *
+ * Do not wait for a job from a task of the same executor, which may deadlock.
+ */
+class Executor {
+public:
+  /**
+   * Tasks of a parse job.
+   */
+  class Job {
+  public:
+    /**
+     * @param priority Jobs with higher priority are served first.
+     */
+    explicit Job(Executor & executor, int priority = 0)
+    : executor(executor), priority(priority), n_running(0), queued(false)
+    {}
+
+    /**
+     * Wait for all tasks.
+     */
+    ~Job() {
+      std::unique_lock<std::mutex> lock(executor.mutex);
+      idle_cond.wait(lock, [this]() { return tasks.empty() && n_running == 0; });
+    }
+
+    /**
+     * Submit \p task, which may submit more tasks to this job. Thread-safe.
+     */
+    inline void submit(const std::function<void()> & task) {
+      {
+        std::lock_guard<std::mutex> lock(executor.mutex);
+        tasks.push_back(task);
+        if (!queued) {
+          executor.ready_jobs[priority].push_back(this);
+          queued = true;
+        }
+      }
+      executor.task_cond.notify_one();
+    }
+
+    /**
+     * Wait until all tasks (including ones submitted by tasks) finish.
+     * @throw Exception thrown first by a task.
+     */
+    inline void wait() {
+      std::unique_lock<std::mutex> lock(executor.mutex);
+      idle_cond.wait(lock, [this]() { return tasks.empty() && n_running == 0; });
+      if (error) {
+        std::exception_ptr e = error;
+        error = std::exception_ptr();
+        std::rethrow_exception(e);
+      }
+    }
+
+  private:
+    friend class Executor;
+
+    Executor & executor;
+    const int priority;
+    std::deque<std::function<void()> > tasks;
+    size_t n_running;
+    bool queued;  // in executor.ready_jobs
+    std::condition_variable idle_cond;
+    std::exception_ptr error;
+
+    PREVENT_CLASS_DEFAULT_METHODS(Job);
+  };
+
+  /**
+   * Constructor.
+   * @param n_workers Number of worker threads.
+   */
+  explicit Executor(size_t n_workers)
+  : stopping(false), detached_job(*this)
+  {
+    ASSERT(n_workers >= 1);
+    for (size_t i = 0; i < n_workers; ++i) workers.push_back(std::thread(&Executor::work, this));
+  }
+
+  /**
+   * Finish submitted tasks and stop workers.
+   */
+  ~Executor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    task_cond.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+  }
+
+  /**
+   * Return the process-wide executor, which has as many workers as available CPUs. Created at the first call.
+   */
+  static Executor & get_shared();
+
+  inline size_t get_n_workers() const { return workers.size(); }
+
+  /**
+   * Run \p task without a job to wait for, e.g. to resume a coroutine. Thread-safe.
+   * Exceptions thrown by \p task are ignored.
+   */
+  inline void post(const std::function<void()> & task) { detached_job.submit(task); }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable task_cond;
+  std::map<int, std::deque<Job *> > ready_jobs;  // jobs with tasks, by priority
+  bool stopping;
+  Job detached_job;  // of post(). Destroyed first, after workers finish all tasks.
+
+  inline void work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      task_cond.wait(lock, [this]() { return stopping || !ready_jobs.empty(); });
+      if (ready_jobs.empty()) return;  // stopping
+
+      // take a task from the first job of the highest priority, then move the job to the back
+      std::map<int, std::deque<Job *> >::iterator it = --ready_jobs.end();
+      Job * job = it->second.front();
+      it->second.pop_front();
+      std::function<void()> task = job->tasks.front();
+      job->tasks.pop_front();
+      if (job->tasks.empty()) job->queued = false;
+      else it->second.push_back(job);
+      if (it->second.empty()) ready_jobs.erase(it);
+      ++job->n_running;
+
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        task();
+      }
+      catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+
+      if (error && !job->error) job->error = error;
+      if (--job->n_running == 0 && job->tasks.empty()) job->idle_cond.notify_all();
+    }
+  }
+
+  PREVENT_CLASS_DEFAULT_METHODS(Executor);
+};
+
+/**
+ * Columns of a row seen through a projection, passed to ScanConsumer::consume() without copying columns.
+ * Valid only during the call.
+ */
+class ProjectedRow {
+public:
+  /**
+   * @param row All columns of the row.
+   * @param projection Indexes of columns in \p row, in order of columns of this view. Empty to see all columns.
+   */
+  ProjectedRow(const std::vector<std::string> & row, const std::vector<size_t> & projection)
+  : row(row), projection(projection)
+  {}
+
+  inline size_t size() const { return projection.empty() ? row.size() : projection.size(); }
+
+  inline const std::string & operator[](size_t i) const { return projection.empty() ? row[i] : row[projection[i]]; }
+
+  /**
+   * Copy projected columns to \p out.
+   */
+  inline void copy_to(/* out */ std::vector<std::string> & out) const {
+    if (projection.empty()) {
+      out = row;
+      return;
+    }
+    out.resize(projection.size());
+    for (size_t i = 0; i < projection.size(); ++i) out[i] = row[projection[i]];
+  }
+
+private:
+  const std::vector<std::string> & row;
+  const std::vector<size_t> & projection;
+
+  PREVENT_CLASS_DEFAULT_METHODS(ProjectedRow);
+};
+
+/**
+ * Consumer of rows in ParallelCsvParser::parse_shared(), which splits each chunk once and passes rows to several consumers,
+ * so that N aggregations over a CSV cost roughly one scan.
+ *
+ * Subclasses keep their own state for each worker, since consume() is called from worker threads concurrently.
+ * See StatefulScanConsumer for a subclass managing per-worker states.
+ */
+class ScanConsumer {
+public:
+  /**
+   * @param projection Indexes of columns passed to consume(), in this order. Empty to pass all columns.
+   */
+  explicit ScanConsumer(const std::vector<size_t> & projection = std::vector<size_t>())
+  : projection(projection)
+  {}
+
+  virtual ~ScanConsumer() {}
+
+  inline const std::vector<size_t> & get_projection() const { return projection; }
+
+  /**
+   * Called before parsing. Prepare state for workers 0 to \p n_workers - 1.
+   */
+  virtual void start(size_t n_workers) {}
+
+  /**
+   * Called for each row by worker \p i_worker. Calls with the same \p i_worker are never concurrent, and rows are not ordered.
+   * @param row Projected columns of the row, which refer to the row shared by all consumers. Call ProjectedRow::copy_to() to keep them.
+   * @param line_number 1-origin line number if ParallelCsvParser::set_line_numbering() is enabled. Otherwise 0.
+   */
+  virtual void consume(size_t i_worker, const ProjectedRow & row, size_t line_number) = 0;
+
+  /**
+   * Called after all workers finish successfully. Merge per-worker states here.
+   */
+  virtual void finish() {}
+
+private:
+  const std::vector<size_t> projection;
+};
+
+/**
+ * ScanConsumer with a \p State for each worker. States are separated by padding to avoid false sharing among workers.
+ * @tparam State Default-constructible state, e.g. partial sums.
+ */
+template <class State>
+class StatefulScanConsumer : public ScanConsumer {
+public:
+  explicit StatefulScanConsumer(const std::vector<size_t> & projection = std::vector<size_t>())
+  : ScanConsumer(projection)
+  {}
+
+  virtual void start(size_t n_workers) {
+    slots.clear();
+    slots.resize(n_workers);
+  }
+
+  virtual void consume(size_t i_worker, const ProjectedRow & row, size_t line_number) {
+    update(slots[i_worker].state, row, line_number);
+  }
+
+  /**
+   * Called for each row with \p state of the worker. See ScanConsumer::consume().
+   */
+  virtual void update(State & state, const ProjectedRow & row, size_t line_number) = 0;
+
+  inline size_t get_n_states() const { return slots.size(); }
+  inline const State & get_state(size_t i_worker) const { return slots[i_worker].state; }
+
+private:
+  typedef struct slot_t {
+    State state;
+    char padding[64];
+  } slot_t;
+
+  std::vector<slot_t> slots;
+};
+
+/**
+ * Parser to split CSV into rows and columns with multiple threads.
+ *
+ * CSV body is divided into chunks of \p chunk_size bytes.
+ * Worker threads take chunks in file order and parse each of them with PartialCsvParser,
+ * so all lines are parsed exactly once.
+ */
+class ParallelCsvParser {
+public:
+  /**
+   * Pass as \p n_threads or \p chunk_size of constructor to let ParallelCsvParser choose it.
+   */
+  static const size_t AUTO = 0;
+
+  /**
+   * Constructor.
+   * @param csv_config Instance of Memory::CsvConfig or its child class.
+   * @param n_threads Number of worker threads.
+   *   If AUTO, 1 thread per MIN_BYTES_PER_THREAD of CSV body, up to available_cpus().
+   * @param chunk_size Byte length of a chunk, which is a unit of work taken by a worker thread.
+   *   If AUTO, CSV body is divided into about AUTO_CHUNKS_PER_THREAD chunks per thread (but not smaller than MIN_AUTO_CHUNK_SIZE),
+   *   and workers take consecutive chunks at once in decreasing number (guided scheduling):
+   *   large units while a lot of work remains, and single chunks at the end to keep all workers busy.
+   */
+  ParallelCsvParser(
+    const Memory::CsvConfig & csv_config,
+    size_t n_threads,
+    size_t chunk_size = DEFAULT_CHUNK_SIZE)
+  : csv_config(csv_config),
+    n_threads(n_threads == AUTO ? auto_n_threads(csv_config) : n_threads),
+    chunk_size(chunk_size == AUTO ? auto_chunk_size(csv_config, this->n_threads) : chunk_size),
+    guided_scheduling(chunk_size == AUTO),
+    line_numbering(false), cancellation_token(NULL), n_chunks_to_parse(0),
+    progress_interval(0), worker_counters(this->n_threads), start_ticks(0), finished(false),
+    tracer(NULL), latency_histogram(NULL), executor(NULL), executor_priority(0), governor(NULL)
+  {
+    ASSERT(this->n_threads >= 1);
+    ASSERT(this->chunk_size >= 1);
+  }
+
+  /**
+   * CSV body smaller than this is parsed by 1 thread when n_threads is AUTO, since starting threads costs more than parsing.
+   */
+  static const size_t MIN_BYTES_PER_THREAD = 1024 * 1024;
+
+  static const size_t AUTO_CHUNKS_PER_THREAD = 16;
+  static const size_t MIN_AUTO_CHUNK_SIZE = 64 * 1024;
+
+  /**
+   * Return the number of CPUs this process can use:
+   * CPUs in affinity mask, limited by CPU quota of cgroup (v2 cpu.max or v1 cpu.cfs_quota_us) as in containers.
+   */
+  static inline size_t available_cpus() {
+    size_t n_cpus = std::thread::hardware_concurrency();
+#ifdef CPU_COUNT
+    cpu_set_t cpu_set;
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) n_cpus = CPU_COUNT(&cpu_set);
+#endif
+    const double quota = cgroup_cpu_quota();
+    if (quota > 0) n_cpus = std::min(n_cpus, size_t(quota + 0.999));
+    return std::max(n_cpus, size_t(1));
+  }
+
+  /**
+   * Return the number of worker threads.
+   */
+  inline size_t get_n_threads() const { return n_threads; }
+
+  /**
+   * Return the byte length of a chunk.
+   */
+  inline size_t get_chunk_size() const { return chunk_size; }
+
+  ~ParallelCsvParser() {}
+
+  /**
+   * Pass global line numbers to visitor of parse().
+   * Before parsing, line terminators in each chunk are counted in parallel and their prefix sum gives
+   * the line number of each chunk's beginning. It costs an extra scan of the CSV.
+   * Otherwise, 0 is passed as line number.
+   * Line numbers in PCPCsvError are always available regardless of this flag.
+   */
+  inline void set_line_numbering(bool enabled) { line_numbering = enabled; }
+
+  /**
+   * Stop parsing when \p token is cancelled. parse(), parse_limit() and validate() throw PCPCancelledError then.
+   * It is checked every time a worker takes a chunk, and every PartialCsvParser::CANCELLATION_CHECK_INTERVAL lines in a chunk.
+   * @param token NULL disables cancellation.
+   */
+  inline void set_cancellation_token(const CancellationToken * token) { cancellation_token = token; }
+
+  /**
+   * Call \p callback periodically with progress while parsing.
+   * It is called from a monitor thread every \p interval, and once more when parsing finishes.
+   * @param callback Called as \p callback(progress) where \p progress is <tt>const progress_t &</tt>.
+   */
+  template <class Rep, class Period>
+  inline void set_progress_callback(const std::function<void(const progress_t &)> & callback, const std::chrono::duration<Rep, Period> & interval) {
+    progress_callback = callback;
+    progress_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+  }
+
+  /**
+   * Record timeline of workers to \p tracer: fetching chunks, parsing chunks (with page faults),
+   * and time spent in PartialCsvParser::get_row() (scan and materialize) and in visitor for each chunk.
+   * @param tracer NULL disables tracing (default), which costs only a branch per chunk and per row.
+   */
+  inline void set_tracer(Tracer * tracer) { this->tracer = tracer; }
+
+  /**
+   * Record latency of each chunk (from taking it to finishing it) to \p histogram.
+   * Workers record to their own histograms, which are merged to \p histogram when all workers finish.
+   * @param histogram NULL disables recording (default).
+   */
+  inline void set_latency_histogram(LatencyHistogram * histogram) { latency_histogram = histogram; }
+
+  /**
+   * Run workers as tasks of \p executor (e.g. Executor::get_shared()) instead of starting threads for each parse.
+   * Up to n_threads tasks of this parser run at once, each parsing a chunk.
+   * Must not be called from a task of \p executor.
+   * @param executor NULL to start threads for each parse (default).
+   * @param priority Priority among jobs of \p executor. See Executor::Job::Job().
+   */
+  inline void set_executor(Executor * executor, int priority = 0) {
+    this->executor = executor;
+    executor_priority = priority;
+  }
+
+  /**
+   * Throttle workers by \p governor: max workers, read budget in bytes/sec, and pause / resume.
+   * Workers wait for \p governor before taking chunks, and charge bytes of chunks to its budget.
+   * @param governor NULL disables throttling (default).
+   */
+  inline void set_resource_governor(ResourceGovernor * governor) { this->governor = governor; }
+
+  /**
+   * Return progress of current (or last) parse. Thread-safe, so it can be polled while parsing.
+   *
+   * Workers update their own counters, padded to separate cache lines, with relaxed stores.
+   * So polling never contends with parsing, while the snapshot may be slightly stale.
+   */
+  inline progress_t get_progress() const {
+    progress_t progress;
+    progress.total_bytes = csv_config.filesize() > csv_config.body_offset() ? csv_config.filesize() - csv_config.body_offset() : 0;
+    progress.bytes_consumed = progress.rows = 0;
+    progress.finished = finished.load(std::memory_order_acquire);
+
+    size_t max_offset = 0;
+    progress.workers.resize(worker_counters.size());
+    for (size_t i = 0; i < worker_counters.size(); ++i) {
+      worker_progress_t & worker = progress.workers[i];
+      worker.bytes_consumed = worker_counters[i].bytes_consumed.load(std::memory_order_relaxed);
+      worker.rows = worker_counters[i].rows.load(std::memory_order_relaxed);
+      worker.current_offset = worker_counters[i].current_offset.load(std::memory_order_relaxed);
+      progress.bytes_consumed += worker.bytes_consumed;
+      progress.rows += worker.rows;
+      max_offset = std::max(max_offset, worker.current_offset);
+    }
+    for (size_t i = 0; i < progress.workers.size(); ++i)
+      progress.workers[i].lag_bytes = max_offset - progress.workers[i].current_offset;
+
+    const std::chrono::steady_clock::rep start = start_ticks.load(std::memory_order_relaxed);
+    progress.elapsed_sec = start == 0 ? 0 : std::chrono::duration<double>(
+      std::chrono::steady_clock::duration(std::chrono::steady_clock::now().time_since_epoch().count() - start)).count();
+    progress.bytes_per_sec = progress.elapsed_sec > 0 ? progress.bytes_consumed / progress.elapsed_sec : 0;
+    progress.eta_sec = progress.finished ? 0 :
+      progress.bytes_per_sec > 0 ? (progress.total_bytes - std::min(progress.total_bytes, progress.bytes_consumed)) / progress.bytes_per_sec : -1;
+    return progress;
+  }
+
+  /**
+   * Skip lines not including any of \p patterns. See PartialCsvParser::set_line_filter().
+   */
+  inline void set_line_filter(const std::vector<std::string> & patterns) { filter_patterns = patterns; }
+
+  /**
+   * Return the number of chunks CSV body is divided into.
+   */
+  inline size_t get_n_chunks() const {
+    if (csv_config.filesize() <= csv_config.body_offset()) return 0;
+    return (csv_config.filesize() - csv_config.body_offset() + chunk_size - 1) / chunk_size;
+  }
+
+  /**
+   * Parse all rows.
+   * @param visitor Called as \p visitor(row, line_number) for each row,
+   *   where \p row is <tt>const std::vector<std::string> &</tt> and \p line_number is 1-origin line number in CSV (see set_line_numbering()).
+   *   It is called from worker threads concurrently, and rows are not ordered.
+   * @throw PCPCsvError Error in the earliest chunk is rethrown after all workers stop.
+   */
+  template <class Visitor>
+  void parse(Visitor visitor) {
+    parse_rows([&](size_t, const std::vector<std::string> & row, size_t line_number) { visitor(row, line_number); });
+  }
+
+  /**
+   * Parse all rows once and pass each row to all of \p consumers, projected by ScanConsumer::get_projection() of each consumer.
+   * ScanConsumer::start() is called with get_n_threads() before parsing, and ScanConsumer::finish() after parsing successfully.
+   * @throw PCPCsvError Error in the earliest chunk is rethrown after all workers stop. ScanConsumer::finish() is not called.
+   */
+  inline void parse_shared(const std::vector<ScanConsumer *> & consumers) {
+    for (size_t i = 0; i < consumers.size(); ++i) {
+      const std::vector<size_t> & projection = consumers[i]->get_projection();
+      for (size_t j = 0; j < projection.size(); ++j) ASSERT(projection[j] < csv_config.get_n_columns());
+      consumers[i]->start(n_threads);
+    }
+
+    // consumers see the same row through their projections, so no column is copied
+    parse_rows([&](size_t i_worker, const std::vector<std::string> & row, size_t line_number) {
+      for (size_t i = 0; i < consumers.size(); ++i)
+        consumers[i]->consume(i_worker, ProjectedRow(row, consumers[i]->get_projection()), line_number);
+    });
+
+    for (size_t i = 0; i < consumers.size(); ++i) consumers[i]->finish();
+  }
+
+  /**
+   * Parse first \p limit rows accepted by \p predicate after skipping \p offset accepted rows, in file order.
+   *
+   * Workers take chunks in file order, and accepted rows are merged chunk by chunk in file order.
+   * Once the merged chunks satisfy \p offset + \p limit rows, workers are cancelled and remaining chunks are never read.
+   *
+   * @param offset Number of accepted rows to skip.
+   * @param limit Maximum number of rows passed to \p visitor.
+   * @param predicate Called as \p predicate(row) from worker threads concurrently. Return true to accept \p row.
+   * @param visitor Called as \p visitor(row, line_number) in file order. It is never called concurrently.
+   *   Line numbers are given without extra scan of the CSV if set_line_numbering() is enabled.
+   * @return Number of rows passed to \p visitor.
+   * @throw PCPCsvError Thrown only if an invalid line precedes the last row to be passed to \p visitor.
+   */
+  template <class Predicate, class Visitor>
+  size_t parse_limit(size_t offset, size_t limit, Predicate predicate, Visitor visitor) {
+    prepare_chunks(false);
+    if (limit == 0) return 0;
+    const size_t n_needed = offset + limit;  // from a chunk at most
+
+    std::vector<std::vector<std::vector<std::string> > > chunk_rows(chunks.size());
+    std::vector<std::vector<size_t> > chunk_line_numbers(chunks.size());  // relative to chunk's beginning
+    std::vector<size_t> chunk_n_terminators(chunks.size(), 0);
+    std::vector<std::unique_ptr<PCPCsvError> > chunk_errors(chunks.size());  // with line number relative to the chunk
+    std::vector<char> chunk_done(chunks.size(), 0);
+
+    std::mutex merge_mutex;
+    size_t n_merged_chunks = 0, n_accepted = 0, n_passed = 0;
+    size_t line_number_base = _count_char(csv_config.content(), csv_config.body_offset(), csv_config.get_line_terminator());
+
+    run_workers("parse chunk with limit", [&](size_t, size_t i_chunk, worker_counters_t & counters) {
+      PartialCsvParser parser(csv_config, chunks[i_chunk].parse_from, chunks[i_chunk].parse_to);
+      setup_parser(parser, i_chunk);
+      parser.set_line_number_base(0);
+
+      try {
+        std::vector<std::string> row;
+        while (chunk_rows[i_chunk].size() < n_needed &&
+               i_chunk < n_chunks_to_parse.load(std::memory_order_relaxed) &&
+               parser.get_row(row)) {
+          const std::vector<std::string> & const_row = row;
+          if (!predicate(const_row)) continue;
+          chunk_rows[i_chunk].push_back(row);
+          chunk_line_numbers[i_chunk].push_back(parser.get_line_number());
+          counters.add_row();
+        }
+      }
+      catch (const PCPCsvError & e) {
+        // rethrown with global line number when merged, unless enough rows precede it
+        chunk_errors[i_chunk].reset(new PCPCsvError(e));
+      }
+      if (line_numbering) {
+        chunk_n_terminators[i_chunk] = _count_char(
+          csv_config.content() + chunks[i_chunk].parse_from,
+          chunks[i_chunk].parse_to - chunks[i_chunk].parse_from + 1,
+          csv_config.get_line_terminator());
+      }
+
+      // merge finished chunks in file order
+      std::lock_guard<std::mutex> lock(merge_mutex);
+      chunk_done[i_chunk] = 1;
+      while (n_passed < limit && n_merged_chunks < n_chunks_to_parse.load(std::memory_order_relaxed) && chunk_done[n_merged_chunks]) {
+        const size_t i = n_merged_chunks++;
+        for (size_t j = 0; j < chunk_rows[i].size() && n_passed < limit; ++j) {
+          if (n_accepted++ < offset) continue;
+          const std::vector<std::string> & const_row = chunk_rows[i][j];
+          visitor(const_row, line_numbering ? line_number_base + chunk_line_numbers[i][j] : 0);
+          ++n_passed;
+        }
+        line_number_base += chunk_n_terminators[i];
+        std::vector<std::vector<std::string> >().swap(chunk_rows[i]);
+
+        if (n_passed == limit || chunk_errors[i]) n_chunks_to_parse.store(i + 1, std::memory_order_relaxed);  // cancel the rest
+        if (n_passed < limit && chunk_errors[i]) {
+          // line_number_base has been advanced to chunk i only if line terminators of preceding chunks are counted
+          const size_t chunk_line_number_base = line_numbering ? line_number_base - chunk_n_terminators[i] :
+            _count_char(csv_config.content(), chunks[i].parse_from, csv_config.get_line_terminator());
+          throw rebase_line_number(*chunk_errors[i], chunk_line_number_base);
+        }
+      }
+    });
+    return n_passed;
+  }
+
+  /**
+   * Same as parse_limit(offset, limit, predicate, visitor) but accepts all rows.
+   */
+  template <class Visitor>
+  size_t parse_limit(size_t offset, size_t limit, Visitor visitor) {
+    return parse_limit(offset, limit, accept_all, visitor);
+  }
+
+  /**
+   * Check the number of columns of each line in parallel. See PartialCsvParser::validate().
+   * @param[out] invalid_line_offsets Offsets of invalid lines are appended in ascending order.
+   * @return Number of validated lines.
+   */
+  inline size_t validate(/* out */ std::vector<size_t> & invalid_line_offsets) {
+    prepare_chunks(false);
+    std::vector<size_t> n_lines(chunks.size(), 0);
+    std::vector<std::vector<size_t> > chunk_invalid_line_offsets(chunks.size());
+    run_workers("validate chunk", [&](size_t, size_t i_chunk, worker_counters_t & counters) {
+      PartialCsvParser parser(csv_config, chunks[i_chunk].parse_from, chunks[i_chunk].parse_to);
+      parser.set_cancellation_token(cancellation_token);
+      n_lines[i_chunk] = parser.validate(chunk_invalid_line_offsets[i_chunk]);
+      counters.rows.store(counters.rows.load(std::memory_order_relaxed) + n_lines[i_chunk], std::memory_order_relaxed);
+    });
+
+    size_t n_total_lines = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      n_total_lines += n_lines[i];
+      invalid_line_offsets.insert(invalid_line_offsets.end(), chunk_invalid_line_offsets[i].begin(), chunk_invalid_line_offsets[i].end());
+    }
+    return n_total_lines;
+  }
+
+private:
+  static const size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+  const Memory::CsvConfig & csv_config;
+  const size_t n_threads;
+  const size_t chunk_size;
+  const bool guided_scheduling;  // workers take multiple chunks at once
+
+  bool line_numbering;
+  std::vector<std::string> filter_patterns;
+  const CancellationToken * cancellation_token;
+
+  typedef struct chunk_t {
+    size_t parse_from;
+    size_t parse_to;
+  } chunk_t;
+
+  std::vector<chunk_t> chunks;
+  std::vector<size_t> chunk_line_number_bases;  // number of line terminators before each chunk
+  std::atomic<size_t> n_chunks_to_parse;  // workers do not take chunks whose index is no less than this
+
+  static bool accept_all(const std::vector<std::string> &) { return true; }
+
+  static inline size_t body_size(const Memory::CsvConfig & csv_config) {
+    return csv_config.filesize() > csv_config.body_offset() ? csv_config.filesize() - csv_config.body_offset() : 0;
+  }
+
+  static inline size_t auto_n_threads(const Memory::CsvConfig & csv_config) {
+    return std::max(size_t(1), std::min(body_size(csv_config) / MIN_BYTES_PER_THREAD, available_cpus()));
+  }
+
+  static inline size_t auto_chunk_size(const Memory::CsvConfig & csv_config, size_t n_threads) {
+    return std::max(size_t(MIN_AUTO_CHUNK_SIZE), std::min(body_size(csv_config) / (n_threads * AUTO_CHUNKS_PER_THREAD), size_t(DEFAULT_CHUNK_SIZE)));
+  }
+
+  /**
+   * Return the number of CPUs given by CPU quota of cgroup, or 0 if unlimited or unknown.
+   */
+  static inline double cgroup_cpu_quota() {
+    // cgroup v2: "$MAX $PERIOD" or "max $PERIOD"
+    std::ifstream cpu_max("/sys/fs/cgroup/cpu.max");
+    std::string max;
+    double period;
+    if (cpu_max >> max >> period) return max == "max" || period <= 0 ? 0 : std::atof(max.c_str()) / period;
+
+    // cgroup v1: quota is -1 if unlimited
+    const char * dirs[] = { "/sys/fs/cgroup/cpu/", "/sys/fs/cgroup/cpu,cpuacct/" };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+      std::ifstream quota_file((std::string(dirs[i]) + "cpu.cfs_quota_us").c_str());
+      std::ifstream period_file((std::string(dirs[i]) + "cpu.cfs_period_us").c_str());
+      double quota;
+      if (quota_file >> quota && period_file >> period) return quota <= 0 || period <= 0 ? 0 : quota / period;
+    }
+    return 0;
+  }
+
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  /**
+   * Progress counters written only by a worker.
+   * Padded so that counters of different workers never share a cache line.
+   */
+  struct worker_counters_t {
+    std::atomic<size_t> bytes_consumed;
+    std::atomic<size_t> rows;
+    std::atomic<size_t> current_offset;
+    Tracer::event_t * trace_event;  // event of current chunk if tracing, to which tasks add arguments
+    char padding[CACHE_LINE_SIZE * 2 - 3 * sizeof(std::atomic<size_t>) - sizeof(Tracer::event_t *)];
+
+    worker_counters_t() : bytes_consumed(0), rows(0), current_offset(0), trace_event(NULL) {}
+
+    inline void add_row() { rows.store(rows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+  };
+
+  std::function<void(const progress_t &)> progress_callback;
+  std::chrono::steady_clock::duration progress_interval;
+  std::vector<worker_counters_t> worker_counters;
+  std::atomic<std::chrono::steady_clock::rep> start_ticks;
+  std::atomic<bool> finished;
+
+  Tracer * tracer;
+  LatencyHistogram * latency_histogram;
+  Executor * executor;
+  int executor_priority;
+  ResourceGovernor * governor;
+
+  inline void start_progress() {
+    for (size_t i = 0; i < worker_counters.size(); ++i) {
+      worker_counters[i].bytes_consumed.store(0, std::memory_order_relaxed);
+      worker_counters[i].rows.store(0, std::memory_order_relaxed);
+      worker_counters[i].current_offset.store(0, std::memory_order_relaxed);
+    }
+    finished.store(false, std::memory_order_release);
+    start_ticks.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  }
+
+  /**
+   * Divide CSV body into chunks, and count line terminators before each chunk if \p count_line_terminators.
+   */
+  inline void prepare_chunks(bool count_line_terminators) {
+    chunks.resize(get_n_chunks());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      chunks[i].parse_from = csv_config.body_offset() + i * chunk_size;
+      chunks[i].parse_to = std::min(chunks[i].parse_from + chunk_size - 1, csv_config.filesize() - 1);
+    }
+
+    chunk_line_number_bases.clear();
+    if (!count_line_terminators) return;
+
+    // count line terminators in each chunk in parallel, then prefix sum
+    std::vector<size_t> n_terminators(chunks.size(), 0);
+    run_workers("count lines in chunk", [&](size_t, size_t i_chunk, worker_counters_t &) {
+      n_terminators[i_chunk] = _count_char(
+        csv_config.content() + chunks[i_chunk].parse_from,
+        chunks[i_chunk].parse_to - chunks[i_chunk].parse_from + 1,
+        csv_config.get_line_terminator());
+    }, false);
+    chunk_line_number_bases.resize(chunks.size());
+    size_t base = _count_char(csv_config.content(), csv_config.body_offset(), csv_config.get_line_terminator());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      chunk_line_number_bases[i] = base;
+      base += n_terminators[i];
+    }
+  }
+
+  /**
+   * Body of parse(), which passes worker index to \p visitor as \p visitor(i_worker, row, line_number).
+   */
+  template <class Visitor>
+  void parse_rows(Visitor visitor) {
+    prepare_chunks(line_numbering);
+    run_workers("parse chunk", [&](size_t i_worker, size_t i_chunk, worker_counters_t & counters) {
+      PartialCsvParser parser(csv_config, chunks[i_chunk].parse_from, chunks[i_chunk].parse_to);
+      setup_parser(parser, i_chunk);
+
+      std::vector<std::string> row;
+      if (!counters.trace_event) {
+        while (parser.get_row(row)) {
+          const std::vector<std::string> & const_row = row;
+          visitor(i_worker, const_row, line_numbering ? parser.get_line_number() : 0);
+          counters.add_row();
+        }
+        return;
+      }
+
+      // measure time of get_row() and visitor
+      Tracer::clock::duration get_row_time(0), visitor_time(0);
+      size_t n_rows = 0;
+      while (true) {
+        const Tracer::clock::time_point t0 = Tracer::clock::now();
+        if (!parser.get_row(row)) break;
+        const Tracer::clock::time_point t1 = Tracer::clock::now();
+        const std::vector<std::string> & const_row = row;
+        visitor(i_worker, const_row, line_numbering ? parser.get_line_number() : 0);
+        counters.add_row();
+        get_row_time += t1 - t0;
+        visitor_time += Tracer::clock::now() - t1;
+        ++n_rows;
+      }
+      counters.trace_event->add_arg("rows", n_rows);
+      counters.trace_event->add_arg("get_row_us", std::chrono::duration<double, std::micro>(get_row_time).count());
+      counters.trace_event->add_arg("visitor_us", std::chrono::duration<double, std::micro>(visitor_time).count());
+    });
+  }
+
+  /**
+   * Return \p error of PartialCsvParser with line number base 0, with its line number (also in its message)
+   * moved forward by \p n_line_terminators_before.
+   */
+  static inline PCPCsvError rebase_line_number(const PCPCsvError & error, size_t n_line_terminators_before) {
+    const size_t line_number = n_line_terminators_before + error.get_line_number();
+    std::string message(error.what());
+    std::ostringstream relative_label, global_label;
+    relative_label << "(line " << error.get_line_number() << ")";
+    global_label << "(line " << line_number << ")";
+    const size_t label_pos = message.find(relative_label.str());
+    if (label_pos != std::string::npos) message.replace(label_pos, relative_label.str().size(), global_label.str());
+    return PCPCsvError(message, line_number);
+  }
+
+  inline void setup_parser(PartialCsvParser & parser, size_t i_chunk) const {
+    parser.set_cancellation_token(cancellation_token);
+    if (!chunk_line_number_bases.empty()) parser.set_line_number_base(chunk_line_number_bases[i_chunk]);
+    if (!filter_patterns.empty()) parser.set_line_filter(filter_patterns);
+  }
+
+  /**
+   * Run \p task(i_worker, i_chunk, counters) for all chunks with worker threads,
+   * where \p i_worker is index of the worker (less than n_threads) and \p counters is worker_counters_t of the worker.
+   * Each run of \p task is traced as \p name.
+   * Workers stop taking new chunks after a task throws, and the exception from the earliest chunk is rethrown.
+   * Tasks may lower n_chunks_to_parse to cancel the later chunks.
+   * @param track_progress If true, progress is reset and tracked, and progress callback is called.
+   * @throw PCPCancelledError Thrown if cancellation_token is cancelled before all chunks are taken.
+   */
+  template <class ChunkTask>
+  inline void run_workers(const char * name, ChunkTask task, bool track_progress = true) {
+    std::atomic<size_t> next_chunk(0);
+    std::atomic<bool> failed(false);
+    n_chunks_to_parse.store(chunks.size());
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    size_t error_chunk = chunks.size();
+
+    if (track_progress) start_progress();
+    if (tracer) tracer->reserve_threads(n_threads);
+    std::vector<LatencyHistogram> worker_latencies(track_progress && latency_histogram ? n_threads : 0);
+
+    // parse a chunk, and return false if the worker should stop.
+    auto parse_chunk = [&](size_t i_worker, size_t i_chunk, worker_counters_t & counters) -> bool {
+      if (cancellation_token && cancellation_token->is_cancelled()) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (i_chunk < error_chunk) {
+          error = std::make_exception_ptr(PCPCancelledError("Parsing is cancelled"));
+          error_chunk = i_chunk;
+        }
+        failed = true;
+        return false;
+      }
+      const size_t chunk_bytes = chunks[i_chunk].parse_to - chunks[i_chunk].parse_from + 1;
+      Tracer::event_t chunk_event;
+      long n_major_faults = 0, n_minor_faults = 0;
+      if (tracer) {
+        chunk_event = tracer->begin(name);
+        chunk_event.add_arg("chunk", i_chunk);
+        chunk_event.add_arg("offset", chunks[i_chunk].parse_from);
+        chunk_event.add_arg("bytes", chunk_bytes);
+        counters.trace_event = &chunk_event;
+        _thread_page_faults(&n_major_faults, &n_minor_faults);
+      }
+      const std::chrono::steady_clock::time_point chunk_start =
+        worker_latencies.empty() ? std::chrono::steady_clock::time_point() : std::chrono::steady_clock::now();
+
+      try {
+        counters.current_offset.store(chunks[i_chunk].parse_from, std::memory_order_relaxed);
+        task(i_worker, i_chunk, counters);
+        counters.bytes_consumed.store(counters.bytes_consumed.load(std::memory_order_relaxed) + chunk_bytes, std::memory_order_relaxed);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (i_chunk < error_chunk) {
+          error = std::current_exception();
+          error_chunk = i_chunk;
+        }
+        failed = true;
+      }
+
+      if (!worker_latencies.empty()) worker_latencies[i_worker].record(std::chrono::steady_clock::now() - chunk_start);
+      if (tracer) {
+        long n_major_faults_after, n_minor_faults_after;
+        _thread_page_faults(&n_major_faults_after, &n_minor_faults_after);
+        if (n_major_faults >= 0) {
+          chunk_event.add_arg("major_page_faults", n_major_faults_after - n_major_faults);
+          chunk_event.add_arg("minor_page_faults", n_minor_faults_after - n_minor_faults);
+        }
+        counters.trace_event = NULL;
+        tracer->end(i_worker, chunk_event);
+      }
+      return true;
+    };
+
+    // state of a worker, which is a thread, or a sequence of tasks in executor
+    struct worker_state_t {
+      worker_counters_t dummy_counters;
+      size_t i_chunk, chunks_end;  // chunks taken by this worker
+      worker_state_t() : i_chunk(0), chunks_end(0) {}
+    };
+    const size_t n_workers = std::min(n_threads, chunks.size());
+    std::vector<worker_state_t> worker_states(n_workers);
+
+    auto stopped = [&]() {
+      return failed.load(std::memory_order_relaxed) || (cancellation_token && cancellation_token->is_cancelled());
+    };
+
+    // take a chunk and parse it, and return false if the worker should stop.
+    auto step = [&](size_t i_worker) -> bool {
+      worker_counters_t & counters = track_progress ? worker_counters[i_worker] : worker_states[i_worker].dummy_counters;
+      size_t & i_chunk = worker_states[i_worker].i_chunk;
+      size_t & chunks_end = worker_states[i_worker].chunks_end;
+      if (failed.load(std::memory_order_relaxed)) return false;
+      if (i_chunk == chunks_end) {
+        // gated workers also stop when other workers have taken all chunks
+        if (governor) governor->wait_for_turn(i_worker, [&]() {
+          return stopped() || next_chunk.load(std::memory_order_relaxed) >= n_chunks_to_parse.load(std::memory_order_relaxed);
+        });
+
+        Tracer::event_t fetch_event;
+        if (tracer) fetch_event = tracer->begin("fetch chunk");
+
+        // guided scheduling: take 1/(2 * n_threads) of remaining chunks
+        size_t n_chunks_to_take = 1;
+        if (guided_scheduling) {
+          const size_t n_taken = next_chunk.load(std::memory_order_relaxed), n_chunks = n_chunks_to_parse.load(std::memory_order_relaxed);
+          if (n_taken < n_chunks) n_chunks_to_take = std::max(size_t(1), (n_chunks - n_taken) / (2 * n_threads));
+        }
+        i_chunk = next_chunk.fetch_add(n_chunks_to_take);
+        chunks_end = i_chunk + n_chunks_to_take;
+
+        if (governor) {
+          const size_t n_chunks = std::min(chunks_end, n_chunks_to_parse.load(std::memory_order_relaxed));
+          if (i_chunk < n_chunks) governor->consume(chunks[n_chunks - 1].parse_to - chunks[i_chunk].parse_from + 1, stopped);
+        }
+        if (tracer && i_chunk < n_chunks_to_parse.load(std::memory_order_relaxed)) {
+          fetch_event.add_arg("chunk", i_chunk);
+          fetch_event.add_arg("n_chunks", n_chunks_to_take);
+          tracer->end(i_worker, fetch_event);
+        }
+      }
+      const size_t i_chunk_to_parse = i_chunk++;
+      if (i_chunk_to_parse >= n_chunks_to_parse.load(std::memory_order_relaxed)) return false;
+      return parse_chunk(i_worker, i_chunk_to_parse, counters);
+    };
+
+    // with executor, each task parses a chunk and submits the next task of the worker,
+    // so that workers of concurrent jobs take turns chunk by chunk.
+    // job is declared after tasks so that it waits for the tasks before they are destroyed.
+    std::vector<std::function<void()> > worker_tasks(executor ? n_workers : 0);
+    std::unique_ptr<Executor::Job> job(executor ? new Executor::Job(*executor, executor_priority) : NULL);
+    for (size_t i = 0; i < worker_tasks.size(); ++i) {
+      worker_tasks[i] = [&, i]() {
+        if (step(i)) job->submit(worker_tasks[i]);
+      };
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < n_workers; ++i) {
+      if (job) job->submit(worker_tasks[i]);
+      else workers.push_back(std::thread([&, i]() { while (step(i)) ; }));
+    }
+
+    // monitor thread to call progress callback periodically
+    std::mutex monitor_mutex;
+    std::condition_variable monitor_cond;
+    bool workers_joined = false;
+    std::thread monitor;
+    if (track_progress && progress_callback && progress_interval.count() > 0) {
+      monitor = std::thread([&]() {
+        std::unique_lock<std::mutex> lock(monitor_mutex);
+        while (!monitor_cond.wait_for(lock, progress_interval, [&]() { return workers_joined; }))
+          progress_callback(get_progress());
+      });
+    }
+
+    // stop and join the monitor on every path, since destroying a joinable thread calls std::terminate()
+    // (e.g. job->wait() rethrows an exception of executor).
+    struct monitor_joiner_t {
+      std::thread & monitor;
+      std::mutex & mutex;
+      std::condition_variable & cond;
+      bool & workers_joined;
+
+      inline void join() {
+        if (!monitor.joinable()) return;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          workers_joined = true;
+        }
+        cond.notify_one();
+        monitor.join();
+      }
+      ~monitor_joiner_t() { join(); }
+    } monitor_joiner = {monitor, monitor_mutex, monitor_cond, workers_joined};
+
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    if (job) job->wait();
+    for (size_t i = 0; i < worker_latencies.size(); ++i) latency_histogram->merge(worker_latencies[i]);
+
+    monitor_joiner.join();
+    if (track_progress) {
+      finished.store(true, std::memory_order_release);
+      if (progress_callback) progress_callback(get_progress());
+    }
+
+    if (error) std::rethrow_exception(error);
+  }
+
+  PREVENT_CLASS_DEFAULT_METHODS(ParallelCsvParser);
+};
+
+/**
+ * Parse all rows of \p config with \p n_threads threads by \p Parser, which is PartialCsvParser, PartialFixedWidthParser or PartialNdjsonParser.
+ *
+ * Body of \p config is divided into chunks of \p chunk_size bytes, and threads take chunks in file order.
+ * Each chunk is parsed by <tt>Parser(config, parse_from, parse_to)</tt>, so all rows are parsed exactly once as in ParallelCsvParser.
+ * This is a minimal loader for formats other than CSV: scheduling, line numbering, progress and the other options are only in ParallelCsvParser.
+ * @param visitor Called as \p visitor(row) for each row, where \p row is <tt>const std::vector<std::string> &</tt>.
+ *   It is called from worker threads concurrently, and rows are not ordered.
+ * @throw PCPCsvError Error in the earliest chunk is rethrown after all threads stop.
+ */
+template <class Parser, class Config, class Visitor>
+void parse_in_parallel(const Config & config, size_t n_threads, size_t chunk_size, Visitor visitor) {
+  ASSERT(n_threads >= 1);
+  ASSERT(chunk_size >= 1);
+  if (config.filesize() <= config.body_offset()) return;
+  const size_t n_chunks = (config.filesize() - config.body_offset() + chunk_size - 1) / chunk_size;
+
+  std::atomic<size_t> next_chunk(0);
+  std::atomic<bool> failed(false);
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  size_t error_chunk = n_chunks;
+
+  auto work = [&]() {
+    std::vector<std::string> row;
+    for (size_t i_chunk = next_chunk++; i_chunk < n_chunks && !failed.load(std::memory_order_relaxed); i_chunk = next_chunk++) {
+      const size_t parse_from = config.body_offset() + i_chunk * chunk_size;
+      const size_t parse_to = std::min(parse_from + chunk_size, config.filesize()) - 1;
+      try {
+        Parser parser(config, parse_from, parse_to);
+        while (parser.get_row(row)) {
+          const std::vector<std::string> & const_row = row;
+          visitor(const_row);
+        }
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (i_chunk < error_chunk) {
+          error = std::current_exception();
+          error_chunk = i_chunk;
+        }
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min(n_threads, n_chunks); ++i) workers.push_back(std::thread(work));
+  work();
+  for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+
+  if (error) std::rethrow_exception(error);
+}
+
+/**
+ * Pipeline of stages over rows of a ParallelCsvParser: parse -> transform stages -> sink.
+ *
+ * Rows flow in batches through BoundedQueue between stages, and each stage runs with its own number of threads.
+ * Batches are allocated once and recycled from the sink to the parser, so the parser waits when downstream stages are slow
+ * (backpressure), and memory use is bounded by get_n_batches() batches regardless of file size.
+ *
+ * Rows are not ordered, as in ParallelCsvParser::parse().
+ */
+class Pipeline {
+public:
+  /**
+   * Batch of rows passed to stage functions. Stages may modify, remove or add rows.
+   */
+  typedef std::vector<std::vector<std::string> > batch_t;
+
+  /**
+   * Called as \p function(batch) for each batch from threads of the stage concurrently.
+   */
+  typedef std::function<void(batch_t & batch)> stage_function_t;
+
+  static const size_t DEFAULT_BATCH_SIZE = 1024;
+  static const size_t DEFAULT_QUEUE_CAPACITY = 4;
+
+  /**
+   * @param parser Parser of the first stage. Its threads, chunk size, tracer, governor, etc. are used.
+   * @param batch_size Number of rows in a batch from the parser.
+   * @param queue_capacity Number of batches each queue between stages holds.
+   */
+  explicit Pipeline(ParallelCsvParser & parser, size_t batch_size = DEFAULT_BATCH_SIZE, size_t queue_capacity = DEFAULT_QUEUE_CAPACITY)
+  : parser(parser), batch_size(batch_size), queue_capacity(queue_capacity)
+  {
+    ASSERT(batch_size >= 1);
+    ASSERT(queue_capacity >= 1);
+  }
+
+  /**
+   * Add a transform stage after the parser or the last stage added.
+   * @param n_threads Number of threads running \p transform.
+   */
+  inline Pipeline & add_stage(const stage_function_t & transform, size_t n_threads = 1) {
+    ASSERT(n_threads >= 1);
+    stages.push_back(stage_t(transform, n_threads));
+    return *this;
+  }
+
+  /**
+   * Return the number of batches run() with \p n_sink_threads allocates:
+   * enough for each queue to be full while every thread holds a batch.
+   */
+  inline size_t get_n_batches(size_t n_sink_threads = 1) const {
+    size_t n_batches = parser.get_n_threads() + 1 + n_sink_threads;
+    for (size_t i = 0; i < stages.size(); ++i) n_batches += stages[i].n_threads;
+    return n_batches + (stages.size() + 1) * queue_capacity;
+  }
+
+  /**
+   * Run all stages, with \p sink as the last stage, until all rows reach \p sink.
+   * @param n_threads Number of threads running \p sink.
+   * @throw Exception thrown first by the parser or a stage. Then all stages stop.
+   */
+  void run(const stage_function_t & sink, size_t n_threads = 1) {
+    std::vector<stage_t> all_stages(stages);
+    all_stages.push_back(stage_t(sink, n_threads));
+
+    // queues[0] from the parser, queues[i] to all_stages[i]. Free batches are recycled through free_batches.
+    const size_t n_batches = get_n_batches(n_threads);
+    std::vector<batch_t> batches(n_batches);
+    BoundedQueue<batch_t *> free_batches(n_batches);
+    for (size_t i = 0; i < n_batches; ++i) free_batches.push(&batches[i]);
+    std::vector<std::unique_ptr<BoundedQueue<batch_t *> > > queues;
+    for (size_t i = 0; i < all_stages.size(); ++i) queues.push_back(std::unique_ptr<BoundedQueue<batch_t *> >(new BoundedQueue<batch_t *>(queue_capacity)));
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    std::atomic<bool> stopped(false);
+    auto stop_all = [&](std::exception_ptr e) {
+      {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = e;
+      }
+      stopped = true;
+      free_batches.close();
+      for (size_t i = 0; i < queues.size(); ++i) queues[i]->close();
+    };
+
+    // stage threads. The last thread of a stage to finish closes the next queue.
+    std::vector<std::unique_ptr<std::atomic<size_t> > > n_running;
+    std::vector<std::thread> threads;
+    for (size_t i_stage = 0; i_stage < all_stages.size(); ++i_stage) {
+      n_running.push_back(std::unique_ptr<std::atomic<size_t> >(new std::atomic<size_t>(all_stages[i_stage].n_threads)));
+      for (size_t i = 0; i < all_stages[i_stage].n_threads; ++i) {
+        threads.push_back(std::thread([&, i_stage]() {
+          const bool is_sink = i_stage + 1 == all_stages.size();
+          BoundedQueue<batch_t *> & out = is_sink ? free_batches : *queues[i_stage + 1];
+          batch_t * batch;
+          try {
+            while (!stopped.load(std::memory_order_relaxed) && queues[i_stage]->pop(batch)) {
+              all_stages[i_stage].function(*batch);
+              if (is_sink) batch->clear();
+              if (!out.push(batch)) break;
+            }
+          }
+          catch (...) {
+            stop_all(std::current_exception());
+          }
+          if (--*n_running[i_stage] == 0 && !is_sink) queues[i_stage + 1]->close();
+        }));
+      }
+    }
+
+    // parse stage on this thread
+    BatchingConsumer batching(*this, free_batches, *queues[0]);
+    try {
+      parser.parse_shared(std::vector<ScanConsumer *>(1, &batching));
+    }
+    catch (...) {
+      stop_all(std::current_exception());
+    }
+    queues[0]->close();
+
+    for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+    if (error) std::rethrow_exception(error);
+  }
+
+private:
+  typedef struct stage_t {
+    stage_function_t function;
+    size_t n_threads;
+    stage_t(const stage_function_t & function, size_t n_threads) : function(function), n_threads(n_threads) {}
+  } stage_t;
+
+  /**
+   * Collects rows of each parser worker into batches and pushes full batches to the first queue.
+   */
+  class BatchingConsumer : public ScanConsumer {
+  public:
+    BatchingConsumer(const Pipeline & pipeline, BoundedQueue<batch_t *> & free_batches, BoundedQueue<batch_t *> & out)
+    : pipeline(pipeline), free_batches(free_batches), out(out)
+    {}
+
+    virtual void start(size_t n_workers) { worker_batches.assign(n_workers, NULL); }
+
+    virtual void consume(size_t i_worker, const ProjectedRow & row, size_t) {
+      batch_t *& batch = worker_batches[i_worker];
+      if (!batch && !free_batches.pop(batch)) throw PCPCancelledError("Pipeline is stopped");
+      batch->push_back(std::vector<std::string>());
+      row.copy_to(batch->back());
+      if (batch->size() < pipeline.batch_size) return;
+      if (!out.push(batch)) throw PCPCancelledError("Pipeline is stopped");
+      batch = NULL;
+    }
+
+    // flush partially filled batches
+    virtual void finish() {
+      for (size_t i = 0; i < worker_batches.size(); ++i) {
+        if (worker_batches[i] && !out.push(worker_batches[i])) return;
+      }
+    }
+
+  private:
+    const Pipeline & pipeline;
+    BoundedQueue<batch_t *> & free_batches;
+    BoundedQueue<batch_t *> & out;
+    std::vector<batch_t *> worker_batches;
+  };
+
+  ParallelCsvParser & parser;
+  const size_t batch_size;
+  const size_t queue_capacity;
+  std::vector<stage_t> stages;
+
+  PREVENT_CLASS_DEFAULT_METHODS(Pipeline);
+};
+
+inline Executor & Executor::get_shared() {
+  static Executor executor(ParallelCsvParser::available_cpus());
+  return executor;
+}
+
+#ifdef PCP_HAS_COROUTINE
+
+/**
+ * Batch of rows yielded by BatchGenerator and filled by AsyncCsvReader.
+ */
+typedef std::vector<std::vector<std::string> > row_batch_t;
+
+/**
+ * Fill \p batch with up to \p batch_size rows from \p parser. Strings of \p batch are reused.
+ * @return false if no row is left.
+ */
+inline bool _fill_batch(PartialCsvParser & parser, size_t batch_size, /* out */ row_batch_t & batch) {
+  batch.resize(batch_size);
+  size_t n_rows = 0;
+  while (n_rows < batch_size && parser.get_row(batch[n_rows])) ++n_rows;
+  batch.resize(n_rows);
+  return n_rows > 0;
+}
+
+/**
+ * Generator coroutine yielding batches of rows. Rows are parsed lazily when the next batch is requested.
+ *
+ * @code
+ * for (PCP::row_batch_t & batch : PCP::generate_batches(parser, 1024)) { ... }
+ * @endcode
+ */
+class BatchGenerator {
+public:
+  class promise_type {
+  public:
+    inline BatchGenerator get_return_object() { return BatchGenerator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    inline std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+    inline std::suspend_always final_suspend() noexcept { return std::suspend_always(); }
+    inline std::suspend_always yield_value(row_batch_t & batch) noexcept {
+      current = &batch;
+      return std::suspend_always();
+    }
+    inline void return_void() {}
+    inline void unhandled_exception() { error = std::current_exception(); }
+
+  private:
+    friend class BatchGenerator;
+    row_batch_t * current = nullptr;
+    std::exception_ptr error;
+  };
+
+  class iterator {
+  public:
+    inline row_batch_t & operator*() const { return *handle.promise().current; }
+    inline iterator & operator++() {
+      resume(handle);
+      return *this;
+    }
+    inline bool operator==(std::default_sentinel_t) const { return handle.done(); }
+
+  private:
+    friend class BatchGenerator;
+    std::coroutine_handle<promise_type> handle;
+    explicit iterator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+  };
+
+  BatchGenerator(BatchGenerator && other) noexcept : handle(other.handle) { other.handle = nullptr; }
+
+  ~BatchGenerator() {
+    if (handle) handle.destroy();
+  }
+
+  /**
+   * Parse the first batch.
+   * @throw PCPCsvError Also thrown by iterator::operator++() for later batches.
+   */
+  inline iterator begin() {
+    resume(handle);
+    return iterator(handle);
+  }
+
+  inline std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+  std::coroutine_handle<promise_type> handle;
+
+  explicit BatchGenerator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+  static inline void resume(std::coroutine_handle<promise_type> handle) {
+    handle.resume();
+    if (handle.promise().error) std::rethrow_exception(handle.promise().error);
+  }
+
+  BatchGenerator(const BatchGenerator &) = delete;
+  BatchGenerator & operator=(const BatchGenerator &) = delete;
+};
+
+/**
+ * Yield batches of up to \p batch_size rows from \p parser. A yielded batch is reused for the next batch.
+ */
+inline BatchGenerator generate_batches(PartialCsvParser & parser, size_t batch_size) {
+  row_batch_t batch;
+  while (_fill_batch(parser, batch_size, batch)) co_yield batch;
+}
+
+/**
+ * Reader of a CSV range for coroutines. Awaiting next_batch() suspends the coroutine while the batch is parsed
+ * by a worker of Executor, and the coroutine is resumed on that worker.
+ * So a few executor workers interleave many readers, without a thread per file or blocking the awaiting thread.
+ *
+ * @code
+ * PCP::AsyncCsvReader reader(csv_config);
+ * PCP::row_batch_t batch;
+ * while (co_await reader.next_batch(batch)) { ... }
+ * @endcode
+ */
+class AsyncCsvReader {
+public:
+  static const size_t DEFAULT_BATCH_SIZE = 1024;
+
+  /**
+   * Awaitable of next_batch(). Returns false from co_await if no row is left.
+   */
+  class NextBatch {
+  public:
+    inline bool await_ready() const noexcept { return false; }
+
+    inline void await_suspend(std::coroutine_handle<> handle) {
+      reader.executor.post([this, handle]() {
+        try {
+          has_rows = _fill_batch(reader.parser, reader.batch_size, batch);
+        }
+        catch (...) {
+          error = std::current_exception();
+        }
+        handle.resume();  // this awaitable may be destroyed from here
+      });
+    }
+
+    /**
+     * @throw PCPCsvError Thrown if the batch has an invalid line.
+     */
+    inline bool await_resume() {
+      if (error) std::rethrow_exception(error);
+      return has_rows;
+    }
+
+  private:
+    friend class AsyncCsvReader;
+    AsyncCsvReader & reader;
+    row_batch_t & batch;
+    bool has_rows;
+    std::exception_ptr error;
+
+    NextBatch(AsyncCsvReader & reader, row_batch_t & batch) : reader(reader), batch(batch), has_rows(false) {}
+  };
+
+  /**
+   * @param csv_config CSV to read.
+   * @param batch_size Maximum number of rows in a batch.
+   * @param executor Executor parsing batches.
+   */
+  explicit AsyncCsvReader(const Memory::CsvConfig & csv_config, size_t batch_size = DEFAULT_BATCH_SIZE, Executor & executor = Executor::get_shared())
+  : parser(csv_config), batch_size(batch_size), executor(executor)
+  {
+    ASSERT(batch_size >= 1);
+  }
+
+  /**
+   * Return an awaitable filling \p batch with next rows. Do not await next batches of a reader concurrently.
+   */
+  inline NextBatch next_batch(/* out */ row_batch_t & batch) { return NextBatch(*this, batch); }
+
+  /**
+   * Return the underlying parser, e.g. to set line filter or cancellation token before reading.
+   */
+  inline PartialCsvParser & get_parser() { return parser; }
+
+private:
+  PartialCsvParser parser;
+  const size_t batch_size;
+  Executor & executor;
+
+  PREVENT_CLASS_DEFAULT_METHODS(AsyncCsvReader);
+};
+
+#endif /* PCP_HAS_COROUTINE */
+
+
+#endif /* __cplusplus >= 201103L */
 
 
 }
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <PartialCsvParser.hpp>
+
+#if defined(PCP_TEST_EXPECT_COROUTINE) && !defined(PCP_HAS_COROUTINE)
+#error "PCP_HAS_COROUTINE is expected to be defined in this build"
+#endif
+
+#ifdef PCP_HAS_COROUTINE
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+using namespace PCP;
+
+// coroutine started immediately and destroyed when finished
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() { return DetachedTask(); }
+    std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+    std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+TEST(BatchGeneratorTest, YieldsAllRowsInBatches) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  PartialCsvParser parser(csv_config);
+
+  std::vector<size_t> batch_sizes;
+  std::vector<std::string> ids;
+  for (row_batch_t & batch : generate_batches(parser, 64)) {
+    batch_sizes.push_back(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) ids.push_back(batch[i][0]);
+  }
+  ASSERT_EQ(16, batch_sizes.size());
+  EXPECT_EQ(64, batch_sizes.front());
+  EXPECT_EQ(1000 - 15 * 64, batch_sizes.back());
+  ASSERT_EQ(1000, ids.size());
+  EXPECT_EQ("1", ids.front());
+  EXPECT_EQ("1000", ids.back());
+}
+
+TEST(BatchGeneratorTest, ParseErrorIsThrown) {
+  Memory::CsvConfig csv_config("a,b\n1,2\n3\n4,5\n");
+  PartialCsvParser parser(csv_config);
+  BatchGenerator batches = generate_batches(parser, 1);
+  BatchGenerator::iterator it = batches.begin();
+  EXPECT_EQ(1, (*it).size());
+  EXPECT_THROW(++it, PCPCsvError);
+}
+
+DetachedTask read_all(AsyncCsvReader & reader, std::atomic<size_t> & n_rows, std::mutex & mutex,
+                      std::set<std::thread::id> & resumed_threads, std::atomic<size_t> & n_done)
+{
+  row_batch_t batch;
+  while (co_await reader.next_batch(batch)) {
+    n_rows += batch.size();
+    std::lock_guard<std::mutex> lock(mutex);
+    resumed_threads.insert(std::this_thread::get_id());
+  }
+  ++n_done;
+}
+
+TEST(AsyncCsvReaderTest, ManyReadersInterleaveOnOneWorker) {
+  const size_t n_readers = 8, n_rows_per_csv = 5000;
+  std::vector<std::string> csvs(n_readers);
+  for (size_t i = 0; i < n_readers; ++i) {
+    std::ostringstream ss;
+    for (size_t row = 0; row < n_rows_per_csv; ++row) ss << i << "," << row << "\n";
+    csvs[i] = ss.str();
+  }
+
+  Executor executor(1);
+  std::vector<std::unique_ptr<Memory::CsvConfig> > csv_configs;
+  std::vector<std::unique_ptr<AsyncCsvReader> > readers;
+  for (size_t i = 0; i < n_readers; ++i) {
+    csv_configs.push_back(std::unique_ptr<Memory::CsvConfig>(new Memory::CsvConfig(csvs[i].size(), csvs[i].data(), false)));
+    readers.push_back(std::unique_ptr<AsyncCsvReader>(new AsyncCsvReader(*csv_configs[i], 100, executor)));
+  }
+
+  std::atomic<size_t> n_rows(0), n_done(0);
+  std::mutex mutex;
+  std::set<std::thread::id> resumed_threads;
+  for (size_t i = 0; i < n_readers; ++i) read_all(*readers[i], n_rows, mutex, resumed_threads, n_done);
+  while (n_done < n_readers) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  EXPECT_EQ(n_readers * n_rows_per_csv, n_rows);
+  ASSERT_EQ(1, resumed_threads.size());  // the executor's worker
+  EXPECT_NE(std::this_thread::get_id(), *resumed_threads.begin());
+}
+
+DetachedTask read_until_error(AsyncCsvReader & reader, std::atomic<int> & result) {
+  row_batch_t batch;
+  try {
+    while (co_await reader.next_batch(batch)) ;
+    result = 1;
+  }
+  catch (const PCPCsvError & e) {
+    result = e.get_line_number() == 3 ? 2 : 3;
+  }
+}
+
+TEST(AsyncCsvReaderTest, ParseErrorIsThrownFromAwait) {
+  Executor executor(1);
+  Memory::CsvConfig csv_config("a,b\n1,2\n3\n4,5\n");
+  AsyncCsvReader reader(csv_config, 1, executor);
+  std::atomic<int> result(0);
+  read_until_error(reader, result);
+  while (result == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_EQ(2, result);
+}
+
+#endif /* PCP_HAS_COROUTINE */
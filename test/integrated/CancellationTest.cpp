@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class CancellationTest : public ::testing::Test {
+protected:
+  CancellationTest() {}
+
+  virtual void SetUp() {
+    for (size_t i = 0; i < 100000; ++i) csv += "1,2,3\n";
+  }
+
+  std::string csv;
+};
+
+TEST_F(CancellationTest, PartialCsvParserAlreadyCancelled) {
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  PartialCsvParser parser(csv_config);
+  CancellationToken token;
+  token.cancel();
+  parser.set_cancellation_token(&token);
+
+  size_t n_rows = 0;
+  std::vector<std::string> row;
+  EXPECT_THROW(while (parser.get_row(row)) ++n_rows, PCPCancelledError);
+  EXPECT_EQ(0, n_rows);
+}
+
+TEST_F(CancellationTest, PartialCsvParserStopsWithinCheckInterval) {
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  PartialCsvParser parser(csv_config);
+  CancellationToken token;
+  parser.set_cancellation_token(&token);
+
+  size_t n_rows = 0;
+  std::vector<std::string> row;
+  try {
+    while (parser.get_row(row)) {
+      if (++n_rows == 10) token.cancel();
+    }
+    FAIL();
+  }
+  catch (const PCPCancelledError &) {}
+  EXPECT_GE(10 + PartialCsvParser::CANCELLATION_CHECK_INTERVAL, n_rows);
+}
+
+TEST_F(CancellationTest, PartialCsvParserWithNonMatchingLineFilter) {
+  // a line filter rejecting every line must not scan the whole range in one get_row() without checking the token
+  std::string large_csv;
+  for (size_t i = 0; i < 30; ++i) large_csv += csv;  // 18 MB
+  Memory::CsvConfig csv_config(large_csv.c_str(), false);
+  PartialCsvParser parser(csv_config);
+  parser.set_line_filter(std::vector<std::string>(1, "no such pattern"));
+  CancellationToken token;
+  token.cancel();
+  parser.set_cancellation_token(&token);
+
+  std::vector<std::string> row;
+  EXPECT_THROW(parser.get_row(row), PCPCancelledError);
+
+  // without cancellation, the filter still finds a pattern across search windows
+  const std::string pattern = "pattern";
+  std::string csv_with_pattern(2 * 1024 * 1024 - 3, '1');
+  csv_with_pattern += "\n1" + pattern + "\n" + std::string(1024 * 1024, '2') + "\n";
+  Memory::CsvConfig csv_config_with_pattern(csv_with_pattern.c_str(), false);
+  PartialCsvParser parser_with_pattern(csv_config_with_pattern);
+  parser_with_pattern.set_line_filter(std::vector<std::string>(1, pattern));
+  CancellationToken never_cancelled;
+  parser_with_pattern.set_cancellation_token(&never_cancelled);
+  ASSERT_TRUE(parser_with_pattern.get_row(row));
+  EXPECT_EQ("1" + pattern, row[0]);
+  EXPECT_FALSE(parser_with_pattern.get_row(row));
+}
+
+TEST_F(CancellationTest, PartialCsvParserValidate) {
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  PartialCsvParser parser(csv_config);
+  CancellationToken token;
+  token.cancel();
+  parser.set_cancellation_token(&token);
+
+  std::vector<size_t> invalid_line_offsets;
+  EXPECT_THROW(parser.validate(invalid_line_offsets), PCPCancelledError);
+}
+
+TEST_F(CancellationTest, NotCancelled) {
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  ParallelCsvParser parser(csv_config, 2, 4096);
+  CancellationToken token;
+  token.set_timeout(std::chrono::hours(1));
+  parser.set_cancellation_token(&token);
+
+  std::atomic<size_t> n_rows(0);
+  EXPECT_NO_THROW(parser.parse([&](const std::vector<std::string> & row, size_t line_number) { ++n_rows; }));
+  EXPECT_EQ(100000, n_rows.load());
+}
+
+TEST_F(CancellationTest, ParallelCsvParserCancelledFromVisitor) {
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  ParallelCsvParser parser(csv_config, 2, 4096);
+  CancellationToken token;
+  parser.set_cancellation_token(&token);
+
+  std::atomic<size_t> n_rows(0);
+  EXPECT_THROW(parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    if (++n_rows == 100) token.cancel();
+  }), PCPCancelledError);
+  EXPECT_GT(100000, n_rows.load());
+}
+
+TEST_F(CancellationTest, ParallelCsvParserDeadline) {
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  ParallelCsvParser parser(csv_config, 2, 4096);
+  CancellationToken token;
+  token.set_deadline(CancellationToken::clock::now() - std::chrono::seconds(1));
+  parser.set_cancellation_token(&token);
+
+  size_t n_rows = 0;
+  EXPECT_THROW(parser.parse([&](const std::vector<std::string> & row, size_t line_number) { ++n_rows; }), PCPCancelledError);
+  EXPECT_EQ(0, n_rows);
+
+  std::vector<size_t> invalid_line_offsets;
+  EXPECT_THROW(parser.validate(invalid_line_offsets), PCPCancelledError);
+  EXPECT_THROW(parser.parse_limit(0, 10, [](const std::vector<std::string> & row, size_t line_number) {}), PCPCancelledError);
+}
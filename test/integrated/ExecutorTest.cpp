@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+TEST(ExecutorTest, TasksSubmittedByTasksAreWaited) {
+  Executor executor(2);
+  Executor::Job job(executor);
+  std::atomic<int> n_done(0);
+  std::function<void()> task = [&]() {
+    if (++n_done < 100) job.submit(task);
+  };
+  job.submit(task);
+  job.submit(task);
+  job.wait();
+  EXPECT_EQ(101, n_done);
+}
+
+TEST(ExecutorTest, ExceptionOfTaskIsThrownByWait) {
+  Executor executor(2);
+  Executor::Job job(executor);
+  std::atomic<int> n_done(0);
+  for (int i = 0; i < 10; ++i) {
+    job.submit([&, i]() {
+      if (i == 3) throw std::runtime_error("task 3");
+      ++n_done;
+    });
+  }
+  EXPECT_THROW(job.wait(), std::runtime_error);
+  EXPECT_EQ(9, n_done);
+  job.wait();  // thrown once
+}
+
+TEST(ExecutorTest, JobsOfSamePriorityTakeTurns) {
+  Executor executor(1);
+  std::mutex mutex;
+  std::string order;
+  Executor::Job job_a(executor), job_b(executor);
+  {
+    // hold the only worker until tasks of both jobs are submitted
+    std::unique_lock<std::mutex> hold(mutex);
+    Executor::Job blocker(executor);
+    blocker.submit([&]() { std::lock_guard<std::mutex> lock(mutex); });
+    for (int i = 0; i < 3; ++i) job_a.submit([&]() { order += 'a'; });
+    for (int i = 0; i < 3; ++i) job_b.submit([&]() { order += 'b'; });
+    hold.unlock();
+  }
+  job_a.wait();
+  job_b.wait();
+  EXPECT_EQ("ababab", order);
+}
+
+TEST(ExecutorTest, JobOfHigherPriorityIsServedFirst) {
+  Executor executor(1);
+  std::mutex mutex;
+  std::string order;
+  Executor::Job low(executor, 0), high(executor, 1);
+  {
+    std::unique_lock<std::mutex> hold(mutex);
+    Executor::Job blocker(executor);
+    blocker.submit([&]() { std::lock_guard<std::mutex> lock(mutex); });
+    for (int i = 0; i < 3; ++i) low.submit([&]() { order += 'l'; });
+    for (int i = 0; i < 3; ++i) high.submit([&]() { order += 'h'; });
+    hold.unlock();
+  }
+  low.wait();
+  high.wait();
+  EXPECT_EQ("hhhlll", order);
+}
+
+TEST(ExecutorTest, SharedExecutor) {
+  EXPECT_EQ(&Executor::get_shared(), &Executor::get_shared());
+  EXPECT_EQ(ParallelCsvParser::available_cpus(), Executor::get_shared().get_n_workers());
+}
+
+TEST(ExecutorTest, ConcurrentParsersShareBoundedWorkers) {
+  std::ostringstream ss;
+  const size_t n_rows = 100000;
+  for (size_t i = 0; i < n_rows; ++i) ss << i << ",abcdefghij\n";
+  const std::string csv = ss.str();
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+
+  Executor executor(2);
+  const size_t n_jobs = 4;
+  std::vector<std::vector<std::atomic<int> > > seen(n_jobs);
+  std::vector<std::thread> clients;
+  for (size_t i_job = 0; i_job < n_jobs; ++i_job) {
+    seen[i_job] = std::vector<std::atomic<int> >(n_rows);
+    for (size_t i = 0; i < n_rows; ++i) seen[i_job][i] = 0;
+    clients.push_back(std::thread([&, i_job]() {
+      ParallelCsvParser parser(csv_config, 4, 4096);
+      parser.set_executor(&executor, i_job % 2);
+      parser.parse([&](const std::vector<std::string> & row, size_t) {
+        ++seen[i_job][std::atoi(row[0].c_str())];
+      });
+    }));
+  }
+  for (size_t i = 0; i < clients.size(); ++i) clients[i].join();
+  for (size_t i_job = 0; i_job < n_jobs; ++i_job)
+    for (size_t i = 0; i < n_rows; ++i) ASSERT_EQ(1, seen[i_job][i]) << i_job << ", " << i;
+}
+
+TEST(ExecutorTest, ParseErrorWithExecutor) {
+  Executor executor(2);
+  Memory::CsvConfig csv_config("1,2\n3,4\n5\n6,7\n", false);
+  ParallelCsvParser parser(csv_config, 2, 1);
+  parser.set_executor(&executor);
+  EXPECT_THROW(parser.parse([](const std::vector<std::string> &, size_t) {}), PCPCsvError);
+}
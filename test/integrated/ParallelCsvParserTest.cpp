@@ -0,0 +1,394 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <algorithm>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class ParallelCsvParserTest : public ::testing::TestWithParam<std::tuple<size_t, size_t> > {
+protected:
+  ParallelCsvParserTest() {}
+
+  virtual void SetUp() {
+    n_threads = std::get<0>(GetParam());
+    chunk_size = std::get<1>(GetParam());
+  }
+
+  size_t n_threads, chunk_size;
+};
+
+TEST_P(ParallelCsvParserTest, AllLinesAreParsedExactlyOnce) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+
+  std::mutex mutex;
+  std::vector<std::string> ids;
+  parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ids.push_back(row[0]);
+  });
+
+  ASSERT_EQ(1000, ids.size());
+  std::sort(ids.begin(), ids.end());
+  EXPECT_EQ(ids.end(), std::unique(ids.begin(), ids.end()));
+}
+
+TEST_P(ParallelCsvParserTest, LineNumbers) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  parser.set_line_numbering(true);
+
+  // first column of Realistic_5col_1000row.csv is 1-origin row id, while header is line 1.
+  std::mutex mutex;
+  std::vector<size_t> line_numbers;
+  size_t n_mismatches = 0;
+  parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    std::lock_guard<std::mutex> lock(mutex);
+    line_numbers.push_back(line_number);
+    if (std::to_string(line_number - 1) != row[0]) ++n_mismatches;
+  });
+
+  EXPECT_EQ(0, n_mismatches);
+  std::sort(line_numbers.begin(), line_numbers.end());
+  ASSERT_EQ(1000, line_numbers.size());
+  EXPECT_EQ(2, line_numbers.front());
+  EXPECT_EQ(1001, line_numbers.back());
+}
+
+TEST_P(ParallelCsvParserTest, ErrorHasLineNumberOfEarliestInvalidLine) {
+  std::string csv = "a,b\n";
+  for (size_t i = 0; i < 100; ++i) csv += (i == 30 || i == 70) ? "x\n" : "1,2\n";
+  Memory::CsvConfig csv_config(csv.c_str());
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+
+  try {
+    parser.parse([](const std::vector<std::string> & row, size_t line_number) {});
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(32, e.get_line_number());
+  }
+}
+
+TEST_P(ParallelCsvParserTest, SkipCommentsAndBlankLines) {
+  CsvConfig csv_config("fixture/Valid_WithCommentsAndBlankLines.csv");
+  csv_config.set_comment_prefix('#');
+  csv_config.set_skip_blank_lines(true);
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  parser.set_line_numbering(true);
+
+  std::mutex mutex;
+  std::vector<size_t> line_numbers;
+  parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    std::lock_guard<std::mutex> lock(mutex);
+    line_numbers.push_back(line_number);
+  });
+
+  std::sort(line_numbers.begin(), line_numbers.end());
+  ASSERT_EQ(3, line_numbers.size());
+  EXPECT_EQ(5, line_numbers[0]);
+  EXPECT_EQ(7, line_numbers[1]);
+  EXPECT_EQ(10, line_numbers[2]);
+}
+
+TEST_P(ParallelCsvParserTest, LimitAndOffsetInFileOrder) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  parser.set_line_numbering(true);
+
+  // rows whose id is a multiple of 3
+  std::vector<std::string> ids;
+  std::vector<size_t> line_numbers;
+  size_t n_rows = parser.parse_limit(10, 20,
+    [](const std::vector<std::string> & row) { return std::stoi(row[0]) % 3 == 0; },
+    [&](const std::vector<std::string> & row, size_t line_number) {
+      ids.push_back(row[0]);
+      line_numbers.push_back(line_number);
+    });
+
+  ASSERT_EQ(20, n_rows);
+  ASSERT_EQ(20, ids.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(std::to_string((10 + i + 1) * 3), ids[i]);
+    EXPECT_EQ((10 + i + 1) * 3 + 1, line_numbers[i]);
+  }
+}
+
+TEST_P(ParallelCsvParserTest, LimitTerminatesEarly) {
+  // large enough that workers cannot finish it while the worker of the first chunk is descheduled
+  const size_t n_rows = 1000000;
+  std::string csv;
+  csv.reserve(n_rows * 4);
+  for (size_t i = 0; i < n_rows; ++i) csv += "1,2\n";
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+
+  std::atomic<size_t> n_predicate_calls(0);
+  EXPECT_EQ(5, parser.parse_limit(0, 5,
+    [&](const std::vector<std::string> & row) { ++n_predicate_calls; return true; },
+    [](const std::vector<std::string> & row, size_t line_number) {}));
+  EXPECT_GT(n_rows / 2, n_predicate_calls.load());
+}
+
+TEST_P(ParallelCsvParserTest, LimitBeyondEnd) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+
+  size_t n_rows = 0;
+  EXPECT_EQ(10, parser.parse_limit(990, 100, [&](const std::vector<std::string> & row, size_t line_number) {
+    EXPECT_EQ(std::to_string(990 + ++n_rows), row[0]);
+  }));
+  EXPECT_EQ(0, parser.parse_limit(1000, 100, [&](const std::vector<std::string> & row, size_t line_number) {}));
+  EXPECT_EQ(0, parser.parse_limit(0, 0, [&](const std::vector<std::string> & row, size_t line_number) {}));
+}
+
+TEST_P(ParallelCsvParserTest, LimitStopsBeforeInvalidLine) {
+  std::string csv = "a,b\n";
+  for (size_t i = 0; i < 100; ++i) csv += (i == 70) ? "x\n" : "1,2\n";
+  Memory::CsvConfig csv_config(csv.c_str());
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  parser.set_line_numbering(true);
+
+  size_t n_rows = 0;
+  EXPECT_EQ(70, parser.parse_limit(0, 70, [&](const std::vector<std::string> & row, size_t line_number) {
+    EXPECT_EQ(++n_rows + 1, line_number);
+  }));
+  try {
+    parser.parse_limit(0, 71, [](const std::vector<std::string> & row, size_t line_number) {});
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(72, e.get_line_number());
+    EXPECT_NE(std::string::npos, std::string(e.what()).find("(line 72)"));
+  }
+
+  // line number of the error is global without line numbering
+  parser.set_line_numbering(false);
+  try {
+    parser.parse_limit(0, 71, [](const std::vector<std::string> & row, size_t line_number) {});
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(72, e.get_line_number());
+    EXPECT_NE(std::string::npos, std::string(e.what()).find("(line 72)"));
+  }
+}
+
+TEST_P(ParallelCsvParserTest, Progress) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+
+  std::vector<progress_t> callback_progresses;
+  parser.set_progress_callback([&](const progress_t & progress) {
+    callback_progresses.push_back(progress);
+  }, std::chrono::hours(1));
+
+  std::mutex mutex;
+  size_t last_polled_rows = 0;
+  parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    std::lock_guard<std::mutex> lock(mutex);
+    progress_t progress = parser.get_progress();
+    EXPECT_FALSE(progress.finished);
+    EXPECT_LE(last_polled_rows, progress.rows);
+    last_polled_rows = progress.rows;
+  });
+
+  progress_t progress = parser.get_progress();
+  EXPECT_TRUE(progress.finished);
+  EXPECT_EQ(csv_config.filesize() - csv_config.body_offset(), progress.total_bytes);
+  EXPECT_EQ(progress.total_bytes, progress.bytes_consumed);
+  EXPECT_EQ(1000, progress.rows);
+  EXPECT_EQ(0, progress.eta_sec);
+  ASSERT_EQ(n_threads, progress.workers.size());
+  size_t worker_rows = 0;
+  for (size_t i = 0; i < progress.workers.size(); ++i) worker_rows += progress.workers[i].rows;
+  EXPECT_EQ(1000, worker_rows);
+
+  // only the final callback since interval is long
+  ASSERT_EQ(1, callback_progresses.size());
+  EXPECT_TRUE(callback_progresses[0].finished);
+  EXPECT_EQ(1000, callback_progresses[0].rows);
+}
+
+TEST_P(ParallelCsvParserTest, PeriodicProgressCallback) {
+  std::string csv;
+  for (size_t i = 0; i < 1000; ++i) csv += "1,2\n";
+  Memory::CsvConfig csv_config(csv.c_str(), false);
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+
+  std::atomic<size_t> n_callbacks(0);
+  std::atomic<bool> waited(false);
+  parser.set_progress_callback([&](const progress_t & progress) { ++n_callbacks; }, std::chrono::milliseconds(1));
+  parser.parse([&](const std::vector<std::string> & row, size_t line_number) {
+    // wait for a periodic callback while parsing, however late the monitor thread is scheduled
+    if (waited.exchange(true)) return;
+    const std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (n_callbacks.load() == 0 && std::chrono::steady_clock::now() < timeout)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  EXPECT_LE(2, n_callbacks.load());  // periodic one and final one
+}
+
+TEST_P(ParallelCsvParserTest, Validate) {
+  CsvConfig csv_config("fixture/Invalid_DifferentNumberOfColumns.csv", false);
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  std::vector<size_t> invalid_line_offsets;
+
+  EXPECT_EQ(4, parser.validate(invalid_line_offsets));
+  ASSERT_EQ(1, invalid_line_offsets.size());
+  EXPECT_EQ(12, invalid_line_offsets[0]);
+}
+
+TEST_P(ParallelCsvParserTest, Trace) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  Tracer tracer(parser.get_n_chunks() * 2);
+  parser.set_tracer(&tracer);
+  parser.parse([](const std::vector<std::string> &, size_t) {});
+  EXPECT_EQ(0, tracer.get_n_dropped());
+
+  std::ostringstream ss;
+  tracer.write_chrome_trace(ss);
+  const std::string json = ss.str();
+  EXPECT_EQ(0, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("\"displayTimeUnit\":\"ms\"}"));
+
+  size_t n_chunk_spans = 0, n_fetch_spans = 0;
+  for (size_t pos = 0; (pos = json.find("\"name\":\"parse chunk\"", pos)) != std::string::npos; ++pos) ++n_chunk_spans;
+  for (size_t pos = 0; (pos = json.find("\"name\":\"fetch chunk\"", pos)) != std::string::npos; ++pos) ++n_fetch_spans;
+  EXPECT_EQ(parser.get_n_chunks(), n_chunk_spans);
+  EXPECT_EQ(parser.get_n_chunks(), n_fetch_spans);
+  EXPECT_NE(std::string::npos, json.find("\"get_row_us\":"));
+  EXPECT_NE(std::string::npos, json.find("\"visitor_us\":"));
+  for (size_t i = 0; i < n_threads; ++i) {
+    std::ostringstream name;
+    name << "\"worker " << i << "\"";
+    EXPECT_NE(std::string::npos, json.find(name.str()));
+  }
+}
+
+TEST_P(ParallelCsvParserTest, LatencyOfEachChunkIsRecorded) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  LatencyHistogram histogram;
+  parser.set_latency_histogram(&histogram);
+  parser.parse([](const std::vector<std::string> &, size_t) {});
+  EXPECT_EQ(parser.get_n_chunks(), histogram.get_count());
+
+  // accumulated over parses
+  parser.parse([](const std::vector<std::string> &, size_t) {});
+  EXPECT_EQ(parser.get_n_chunks() * 2, histogram.get_count());
+}
+
+TEST_P(ParallelCsvParserTest, TraceRingBufferKeepsLatestEvents) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  Tracer tracer(2);
+  parser.set_tracer(&tracer);
+  parser.parse([](const std::vector<std::string> &, size_t) {});
+
+  // 2 events (fetch chunk and parse chunk) for each chunk
+  size_t n_kept = 0;
+  std::ostringstream ss;
+  tracer.write_chrome_trace(ss);
+  const std::string json = ss.str();
+  for (size_t pos = 0; (pos = json.find("\"ph\":\"X\"", pos)) != std::string::npos; ++pos) ++n_kept;
+  EXPECT_EQ(parser.get_n_chunks() * 2, n_kept + tracer.get_n_dropped());
+  EXPECT_GE(n_threads * 2, n_kept);
+
+  tracer.clear();
+  EXPECT_EQ(0, tracer.get_n_dropped());
+}
+
+class RowCounter : public StatefulScanConsumer<size_t> {
+public:
+  RowCounter() : n_rows(0) {}
+  virtual void update(size_t & n, const ProjectedRow & row, size_t) {
+    EXPECT_EQ(5, row.size());
+    ++n;
+  }
+  virtual void finish() { for (size_t i = 0; i < get_n_states(); ++i) n_rows += get_state(i); }
+  size_t n_rows;
+};
+
+class IdSum : public StatefulScanConsumer<size_t> {
+public:
+  // 3rd and 1st columns
+  IdSum() : StatefulScanConsumer<size_t>(std::vector<size_t>{2, 0}), sum(0) {}
+  virtual void update(size_t & partial_sum, const ProjectedRow & row, size_t) {
+    EXPECT_EQ(2, row.size());
+    partial_sum += std::atoi(row[1].c_str());
+  }
+  virtual void finish() { for (size_t i = 0; i < get_n_states(); ++i) sum += get_state(i); }
+  size_t sum;
+};
+
+TEST_P(ParallelCsvParserTest, ScanSharing) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, n_threads, chunk_size);
+  RowCounter counter1, counter2;
+  IdSum id_sum;
+  std::vector<ScanConsumer *> consumers{&counter1, &id_sum, &counter2};
+  parser.parse_shared(consumers);
+
+  EXPECT_EQ(1000, counter1.n_rows);
+  EXPECT_EQ(1000, counter2.n_rows);
+  EXPECT_EQ(1000 * 1001 / 2, id_sum.sum);
+  EXPECT_EQ(1000, parser.get_progress().rows);  // split once
+}
+
+INSTANTIATE_TEST_CASE_P(_, ParallelCsvParserTest, ::testing::Combine(
+  ::testing::Values(1UL, 2UL, 4UL),
+  ::testing::Values(1UL, 7UL, 64UL, 4096UL, 1024UL * 1024UL, size_t(ParallelCsvParser::AUTO))
+));
+
+TEST(ParallelCsvParserAutoTuningTest, AvailableCpus) {
+  EXPECT_GE(ParallelCsvParser::available_cpus(), 1);
+  EXPECT_LE(ParallelCsvParser::available_cpus(), std::max(1u, std::thread::hardware_concurrency()));
+}
+
+TEST(ParallelCsvParserAutoTuningTest, SmallFileIsParsedBy1Thread) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  ParallelCsvParser parser(csv_config, ParallelCsvParser::AUTO, ParallelCsvParser::AUTO);
+  EXPECT_EQ(1, parser.get_n_threads());
+  EXPECT_EQ(size_t(ParallelCsvParser::MIN_AUTO_CHUNK_SIZE), parser.get_chunk_size());
+}
+
+TEST(ParallelCsvParserAutoTuningTest, GuidedSchedulingParsesAllLinesExactlyOnce) {
+  // about 8 MB
+  std::ostringstream ss;
+  const size_t n_rows = 400000;
+  for (size_t i = 0; i < n_rows; ++i) ss << i << ",abcdefghij\n";
+  const std::string csv = ss.str();
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+
+  ParallelCsvParser parser(csv_config, ParallelCsvParser::AUTO, ParallelCsvParser::AUTO);
+  EXPECT_GE(parser.get_n_threads(), 1);
+  EXPECT_LE(parser.get_n_threads(), std::min(ParallelCsvParser::available_cpus(), csv.size() / ParallelCsvParser::MIN_BYTES_PER_THREAD));
+  EXPECT_GE(parser.get_chunk_size(), size_t(ParallelCsvParser::MIN_AUTO_CHUNK_SIZE));
+
+  ParallelCsvParser parser4(csv_config, 4, ParallelCsvParser::AUTO);
+  EXPECT_EQ(4, parser4.get_n_threads());
+  EXPECT_EQ(csv.size() / (4 * ParallelCsvParser::AUTO_CHUNKS_PER_THREAD), parser4.get_chunk_size());
+  Tracer tracer;
+  parser4.set_tracer(&tracer);
+
+  std::vector<std::atomic<int> > seen(n_rows);
+  for (size_t i = 0; i < n_rows; ++i) seen[i] = 0;
+  parser4.parse([&](const std::vector<std::string> & row, size_t) {
+    ++seen[std::atoi(row[0].c_str())];
+  });
+  for (size_t i = 0; i < n_rows; ++i) ASSERT_EQ(1, seen[i]) << i;
+
+  // workers take multiple chunks at once
+  std::ostringstream trace;
+  tracer.write_chrome_trace(trace);
+  size_t n_fetches = 0;
+  for (size_t pos = 0; (pos = trace.str().find("\"name\":\"fetch chunk\"", pos)) != std::string::npos; ++pos) ++n_fetches;
+  EXPECT_LT(n_fetches, parser4.get_n_chunks());
+}
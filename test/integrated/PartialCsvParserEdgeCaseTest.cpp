@@ -133,3 +133,71 @@ TEST_F(PartialCsvParserEdgeCaseTest, realistic_ascii_csv) {
   while (!(row = parser.get_row()).empty()) n_total_columns += row.size();
   EXPECT_EQ(5 * 1000, n_total_columns);
 }
+
+TEST_F(PartialCsvParserEdgeCaseTest, validate_different_number_of_columns) {
+  CsvConfig csv_config("fixture/Invalid_DifferentNumberOfColumns.csv");
+  PartialCsvParser parser(csv_config);
+  std::vector<size_t> invalid_line_offsets;
+
+  EXPECT_EQ(3, parser.validate(invalid_line_offsets));
+  ASSERT_EQ(1, invalid_line_offsets.size());
+  EXPECT_EQ(12, invalid_line_offsets[0]);  // "c,c"
+}
+
+TEST_F(PartialCsvParserEdgeCaseTest, validate_continuous_empty_lines) {
+  CsvConfig csv_config("fixture/Invalid_2col_ContinuousLastEmptyLines.csv", false);
+  PartialCsvParser parser(csv_config);
+  std::vector<size_t> invalid_line_offsets;
+
+  parser.validate(invalid_line_offsets);
+  EXPECT_FALSE(invalid_line_offsets.empty());
+}
+
+TEST_F(PartialCsvParserEdgeCaseTest, validate_realistic_ascii_csv_with_partial_parsers) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+
+  for (size_t n_parsers = 1; n_parsers <= 64; n_parsers *= 2) {
+    size_t size_per_parser = (csv_config.filesize() - csv_config.body_offset()) / n_parsers;
+    size_t n_lines = 0;
+    std::vector<size_t> invalid_line_offsets;
+    for (size_t i = 0; i < n_parsers; ++i) {
+      size_t parse_from = csv_config.body_offset() + i * size_per_parser;
+      size_t parse_to = i == n_parsers - 1 ? csv_config.filesize() - 1 : parse_from + size_per_parser - 1;
+      PartialCsvParser parser(csv_config, parse_from, parse_to);
+      n_lines += parser.validate(invalid_line_offsets);
+    }
+    EXPECT_EQ(1000, n_lines) << n_parsers << " parsers";
+    EXPECT_TRUE(invalid_line_offsets.empty());
+  }
+}
+
+TEST_F(PartialCsvParserEdgeCaseTest, line_number_in_error) {
+  CsvConfig csv_config("fixture/Invalid_DifferentNumberOfColumns.csv");
+  PartialCsvParser parser(csv_config);
+
+  parser.get_row();
+  EXPECT_EQ(2, parser.get_line_number());
+  try {
+    parser.get_row();
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(3, e.get_line_number());
+  }
+}
+
+TEST_F(PartialCsvParserEdgeCaseTest, line_number_of_partial_parser) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  const size_t half = csv_config.filesize() / 2;
+  PartialCsvParser parser(csv_config, half);
+  PartialCsvParser parser_with_base(csv_config, half);
+  parser_with_base.set_line_number_base(_count_char(csv_config.content(), half, '\n'));
+
+  std::vector<std::string> row;
+  while (parser.get_row(row)) {
+    // first column is 1-origin row id, while header is line 1.
+    EXPECT_EQ(row[0], std::to_string(parser.get_line_number() - 1));
+    parser_with_base.get_row();
+    EXPECT_EQ(parser.get_line_number(), parser_with_base.get_line_number());
+  }
+}
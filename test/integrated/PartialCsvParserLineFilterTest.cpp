@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class PartialCsvParserLineFilterTest : public ::testing::Test {
+protected:
+  PartialCsvParserLineFilterTest() {}
+
+  virtual void SetUp() {}
+
+  static std::vector<std::string> patterns(const char * p1, const char * p2 = NULL) {
+    std::vector<std::string> v;
+    v.push_back(p1);
+    if (p2) v.push_back(p2);
+    return v;
+  }
+};
+
+TEST_F(PartialCsvParserLineFilterTest, SinglePattern) {
+  const char * const csv =
+    "id,message\n"
+    "1,ok\n"
+    "2,E404 not found\n"
+    "3,ok\n"
+    "4,E404 again\n";
+  Memory::CsvConfig csv_config(csv);
+  PartialCsvParser parser(csv_config);
+  parser.set_line_filter(patterns("E404"));
+
+  std::vector<std::string> row;
+  EXPECT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("2", row[0]);
+  EXPECT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("4", row[0]);
+  EXPECT_TRUE(parser.get_row().empty());
+}
+
+TEST_F(PartialCsvParserLineFilterTest, MultiplePatternsInFileOrder) {
+  const char * const csv =
+    "1,customer_b\n"
+    "2,customer_a\n"
+    "3,customer_c\n"
+    "4,customer_a customer_b\n"
+    "5,customer_b";
+  Memory::CsvConfig csv_config(csv, false);
+  PartialCsvParser parser(csv_config);
+  parser.set_line_filter(patterns("customer_a", "customer_b"));
+
+  std::vector<std::string> row;
+  std::vector<std::string> ids;
+  while (parser.get_row(row)) ids.push_back(row[0]);
+  ASSERT_EQ(4, ids.size());
+  EXPECT_EQ("1", ids[0]);
+  EXPECT_EQ("2", ids[1]);
+  EXPECT_EQ("4", ids[2]);
+  EXPECT_EQ("5", ids[3]);
+}
+
+TEST_F(PartialCsvParserLineFilterTest, NoMatch) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  PartialCsvParser parser(csv_config);
+  parser.set_line_filter(patterns("no such string"));
+  EXPECT_TRUE(parser.get_row().empty());
+}
+
+TEST_F(PartialCsvParserLineFilterTest, ColumnCountIsStillValidated) {
+  CsvConfig csv_config("fixture/Invalid_DifferentNumberOfColumns.csv", false);
+  PartialCsvParser parser(csv_config);
+  parser.set_line_filter(patterns("b", "c"));
+
+  std::vector<std::string> row = parser.get_row();
+  EXPECT_EQ("b", row[0]);
+  EXPECT_THROW(parser.get_row(), PCPCsvError);
+}
+
+TEST_F(PartialCsvParserLineFilterTest, AllMatchingLinesAreParsedExactlyOnceByPartialParsers) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  const std::vector<std::string> filter = patterns(".com", ".org");
+
+  // expected rows from unfiltered parse
+  size_t n_expected_rows = 0;
+  {
+    PartialCsvParser parser(csv_config);
+    std::vector<std::string> row;
+    while (parser.get_row(row)) {
+      for (size_t i = 0; i < row.size(); ++i) {
+        if (row[i].find(".com") != std::string::npos || row[i].find(".org") != std::string::npos) {
+          ++n_expected_rows;
+          break;
+        }
+      }
+    }
+  }
+  ASSERT_LT(0, n_expected_rows);
+
+  for (size_t n_parsers = 1; n_parsers <= 64; n_parsers *= 2) {
+    size_t size_per_parser = (csv_config.filesize() - csv_config.body_offset()) / n_parsers;
+    size_t n_rows = 0;
+    for (size_t i = 0; i < n_parsers; ++i) {
+      size_t parse_from = csv_config.body_offset() + i * size_per_parser;
+      size_t parse_to = i == n_parsers - 1 ? csv_config.filesize() - 1 : parse_from + size_per_parser - 1;
+      PartialCsvParser parser(csv_config, parse_from, parse_to);
+      parser.set_line_filter(filter);
+      std::vector<std::string> row;
+      while (parser.get_row(row)) ++n_rows;
+    }
+    EXPECT_EQ(n_expected_rows, n_rows) << n_parsers << " parsers";
+  }
+}
+
+TEST_F(PartialCsvParserLineFilterTest, LineNumbersCountSkippedLines) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+  PartialCsvParser parser(csv_config, csv_config.filesize() / 3);
+  parser.set_line_filter(patterns(".org"));
+
+  size_t n_rows = 0;
+  std::vector<std::string> row;
+  while (parser.get_row(row)) {
+    // first column is 1-origin row id, while header is line 1.
+    EXPECT_EQ(row[0], std::to_string(parser.get_line_number() - 1));
+    ++n_rows;
+  }
+  EXPECT_LT(0, n_rows);
+}
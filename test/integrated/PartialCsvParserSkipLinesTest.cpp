@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class PartialCsvParserSkipLinesTest : public ::testing::Test {
+protected:
+  PartialCsvParserSkipLinesTest() {}
+
+  virtual void SetUp() {}
+};
+
+TEST_F(PartialCsvParserSkipLinesTest, CommentsAndBlankLines) {
+  CsvConfig csv_config("fixture/Valid_WithCommentsAndBlankLines.csv");
+  csv_config.set_comment_prefix('#');
+  csv_config.set_skip_blank_lines(true);
+
+  std::vector<std::string> headers = csv_config.get_headers();
+  ASSERT_EQ(2, headers.size());
+  EXPECT_EQ("col1", headers[0]);
+  EXPECT_EQ("col2", headers[1]);
+
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+
+  EXPECT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("101", row[0]); EXPECT_EQ("102", row[1]);
+  EXPECT_EQ(5, parser.get_line_number());
+
+  EXPECT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("201", row[0]); EXPECT_EQ("202", row[1]);
+  EXPECT_EQ(7, parser.get_line_number());
+
+  EXPECT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("301", row[0]); EXPECT_EQ("302", row[1]);
+  EXPECT_EQ(10, parser.get_line_number());
+
+  EXPECT_TRUE(parser.get_row().empty());
+}
+
+TEST_F(PartialCsvParserSkipLinesTest, CommentsOnly) {
+  CsvConfig csv_config("fixture/Valid_WithCommentsAndBlankLines.csv", false);
+  csv_config.set_comment_prefix('#');
+  EXPECT_EQ(2, csv_config.get_n_columns());
+
+  PartialCsvParser parser(csv_config);
+  EXPECT_FALSE(parser.get_row().empty());  // "col1,col2"
+  EXPECT_THROW(parser.get_row(), PCPCsvError);  // empty line
+}
+
+TEST_F(PartialCsvParserSkipLinesTest, ContinuousLastEmptyLines) {
+  CsvConfig csv_config("fixture/Invalid_2col_ContinuousLastEmptyLines.csv", false);
+  csv_config.set_skip_blank_lines(true);
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+
+  row = parser.get_row();
+  EXPECT_EQ("a", row[0]); EXPECT_EQ("a", row[1]);
+  row = parser.get_row();
+  EXPECT_EQ("b", row[0]); EXPECT_EQ("b", row[1]);
+  EXPECT_NO_THROW(row = parser.get_row());
+  EXPECT_TRUE(row.empty());
+
+  std::vector<size_t> invalid_line_offsets;
+  PartialCsvParser validator(csv_config);
+  EXPECT_EQ(2, validator.validate(invalid_line_offsets));
+  EXPECT_TRUE(invalid_line_offsets.empty());
+}
+
+TEST_F(PartialCsvParserSkipLinesTest, AllRowsAreParsedExactlyOnceByPartialParsers) {
+  CsvConfig csv_config("fixture/Valid_WithCommentsAndBlankLines.csv");
+  csv_config.set_comment_prefix('#');
+  csv_config.set_skip_blank_lines(true);
+
+  const size_t body_size = csv_config.filesize() - csv_config.body_offset();
+  for (size_t n_parsers = 1; n_parsers <= body_size; ++n_parsers) {
+    size_t size_per_parser = body_size / n_parsers;
+    std::vector<std::string> ids;
+    std::vector<size_t> invalid_line_offsets;
+    size_t n_validated_lines = 0;
+    for (size_t i = 0; i < n_parsers; ++i) {
+      size_t parse_from = csv_config.body_offset() + i * size_per_parser;
+      size_t parse_to = i == n_parsers - 1 ? csv_config.filesize() - 1 : parse_from + size_per_parser - 1;
+      PartialCsvParser parser(csv_config, parse_from, parse_to);
+      std::vector<std::string> row;
+      while (parser.get_row(row)) ids.push_back(row[0]);
+
+      PartialCsvParser validator(csv_config, parse_from, parse_to);
+      n_validated_lines += validator.validate(invalid_line_offsets);
+    }
+    ASSERT_EQ(3, ids.size()) << n_parsers << " parsers";
+    EXPECT_EQ("101", ids[0]);
+    EXPECT_EQ("201", ids[1]);
+    EXPECT_EQ("301", ids[2]);
+    EXPECT_EQ(3, n_validated_lines);
+    EXPECT_TRUE(invalid_line_offsets.empty());
+  }
+}
+
+TEST_F(PartialCsvParserSkipLinesTest, LineFilterDoesNotReturnComments) {
+  CsvConfig csv_config("fixture/Valid_WithCommentsAndBlankLines.csv");
+  csv_config.set_comment_prefix('#');
+  csv_config.set_skip_blank_lines(true);
+
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> patterns;
+  patterns.push_back(",");
+  parser.set_line_filter(patterns);
+
+  size_t n_rows = 0;
+  std::vector<std::string> row;
+  while (parser.get_row(row)) ++n_rows;
+  EXPECT_EQ(3, n_rows);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <PartialCsvParser.hpp>
+
+#if defined(PCP_TEST_EXPECT_PMR) && !defined(PCP_HAS_PMR)
+#error "PCP_HAS_PMR is expected to be defined in this build"
+#endif
+
+using namespace PCP;
+
+class PartialCsvParserWithAllocatorTest : public ::testing::Test {
+protected:
+  PartialCsvParserWithAllocatorTest() {}
+
+  virtual void SetUp() {}
+};
+
+TEST_F(PartialCsvParserWithAllocatorTest, ReuseRow) {
+  CsvConfig csv_config("fixture/WithHeader_2col_3line_WithoutQuote_WithLastNL.csv");
+  std::vector<std::string> headers;
+  csv_config.get_headers(headers);
+  EXPECT_EQ(2, headers.size());
+  EXPECT_EQ("col1", headers[0]);
+  EXPECT_EQ("col2", headers[1]);
+
+  PartialCsvParser parser(csv_config);
+
+  std::vector<std::string> row;
+
+  EXPECT_TRUE(parser.get_row(row));
+  EXPECT_EQ(2, row.size());
+  EXPECT_EQ("101", row[0]);
+  EXPECT_EQ("102", row[1]);
+
+  EXPECT_TRUE(parser.get_row(row));
+  EXPECT_EQ(2, row.size());
+  EXPECT_EQ("201", row[0]);
+  EXPECT_EQ("202", row[1]);
+
+  EXPECT_TRUE(parser.get_row(row));
+  EXPECT_EQ("301", row[0]);
+  EXPECT_EQ("302", row[1]);
+
+  EXPECT_FALSE(parser.get_row(row));
+  EXPECT_TRUE(row.empty());
+}
+
+TEST_F(PartialCsvParserWithAllocatorTest, ReuseRowThrowsOnDifferentNumberOfColumns) {
+  CsvConfig csv_config("fixture/Invalid_DifferentNumberOfColumns.csv");
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+
+  EXPECT_TRUE(parser.get_row(row));
+  EXPECT_THROW(parser.get_row(row), PCPCsvError);
+}
+
+#ifdef PCP_HAS_PMR
+
+// Counts allocations passing through to upstream resource.
+class CountingResource : public std::pmr::memory_resource {
+public:
+  CountingResource() : n_allocations(0) {}
+  size_t n_allocations;
+
+private:
+  void * do_allocate(size_t bytes, size_t alignment) {
+    ++n_allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void * p, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept { return this == &other; }
+};
+
+TEST_F(PartialCsvParserWithAllocatorTest, PmrRowAllocatesFromResource) {
+  const char * const csv =
+    "header_column_longer_than_sso_buffer,b\n"
+    "body_column_longer_than_sso_buffer_1,c\n"
+    "body_column_longer_than_sso_buffer_2,d\n";
+  Memory::CsvConfig csv_config(csv);
+
+  CountingResource resource;
+
+  pmr::row_t headers(&resource);
+  csv_config.get_headers(headers);
+  EXPECT_EQ("header_column_longer_than_sso_buffer", headers[0]);
+  EXPECT_EQ("b", headers[1]);
+  EXPECT_EQ(&resource, headers[0].get_allocator().resource());
+
+  PartialCsvParser parser(csv_config);
+  pmr::row_t row(&resource);
+  const size_t n_allocations_before_parse = resource.n_allocations;
+
+  EXPECT_TRUE(parser.get_row(row));
+  EXPECT_EQ("body_column_longer_than_sso_buffer_1", row[0]);
+  EXPECT_EQ("c", row[1]);
+  EXPECT_EQ(&resource, row[0].get_allocator().resource());
+  EXPECT_LT(n_allocations_before_parse, resource.n_allocations);
+
+  // buffers are reused for the next row
+  const size_t n_allocations_after_first_row = resource.n_allocations;
+  EXPECT_TRUE(parser.get_row(row));
+  EXPECT_EQ("body_column_longer_than_sso_buffer_2", row[0]);
+  EXPECT_EQ("d", row[1]);
+  EXPECT_EQ(n_allocations_after_first_row, resource.n_allocations);
+
+  EXPECT_FALSE(parser.get_row(row));
+}
+
+TEST_F(PartialCsvParserWithAllocatorTest, PmrMonotonicBuffer) {
+  CsvConfig csv_config("fixture/Realistic_5col_1000row.csv");
+
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+  size_t n_total_columns = 0;
+  PartialCsvParser parser(csv_config);
+  pmr::row_t row(&resource);
+  while (parser.get_row(row)) n_total_columns += row.size();
+  EXPECT_EQ(5 * 1000, n_total_columns);
+}
+
+#endif /* PCP_HAS_PMR */
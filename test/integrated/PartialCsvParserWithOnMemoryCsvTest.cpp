@@ -55,3 +55,109 @@ TEST_F(PartialCsvParserWithOnMemoryCsvTest, StringWithLength) {
 
   EXPECT_TRUE((row = parser.get_row()).empty());
 }
+
+TEST_F(PartialCsvParserWithOnMemoryCsvTest, LatencyOfEachGetRowIsRecorded) {
+  const char * const csv =
+    "101,102\n"
+    "201,202\n";
+
+  Memory::CsvConfig csv_config(csv, false);
+  PartialCsvParser parser(csv_config);
+  LatencyHistogram histogram;
+  parser.set_latency_histogram(&histogram);
+
+  std::vector<std::string> row;
+  while (parser.get_row(row)) ;
+  EXPECT_EQ(3, histogram.get_count());  // 2 rows and the last call returning false
+  EXPECT_LE(histogram.get_min(), histogram.get_percentile(50));
+}
+
+TEST_F(PartialCsvParserWithOnMemoryCsvTest, MultiByteFieldTerminator) {
+  const char * const csv =
+    "id||name||note\n"
+    "1||a,b||x|y\n"
+    "2||||\n"
+    "3||c||z\n";
+
+  Memory::CsvConfig csv_config(csv);
+  csv_config.set_field_terminator("||");
+  EXPECT_EQ(3, csv_config.get_n_columns());
+  EXPECT_EQ("||", csv_config.get_field_terminator_string());
+  ASSERT_EQ(3, csv_config.get_headers().size());
+  EXPECT_EQ("note", csv_config.get_headers()[2]);
+
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  ASSERT_EQ(3, row.size());
+  EXPECT_EQ("a,b", row[1]);
+  EXPECT_EQ("x|y", row[2]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("", row[1]);
+  EXPECT_EQ("", row[2]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("z", row[2]);
+  EXPECT_FALSE(parser.get_row(row));
+
+  std::vector<size_t> invalid_line_offsets;
+  PartialCsvParser validator(csv_config);
+  EXPECT_EQ(3, validator.validate(invalid_line_offsets));
+  EXPECT_TRUE(invalid_line_offsets.empty());
+
+  // ranges split in the middle of a terminator still parse each line exactly once
+  const size_t body_offset = csv_config.body_offset(), size = std::strlen(csv);
+  for (size_t split = body_offset + 1; split < size; ++split) {
+    std::vector<std::string> ids;
+    PartialCsvParser parser1(csv_config, body_offset, split - 1);
+    while (parser1.get_row(row)) ids.push_back(row[0]);
+    PartialCsvParser parser2(csv_config, split);
+    while (parser2.get_row(row)) ids.push_back(row[0]);
+    ASSERT_EQ(3, ids.size()) << split;
+    EXPECT_EQ("1", ids[0]);
+    EXPECT_EQ("3", ids[2]);
+  }
+}
+
+TEST_F(PartialCsvParserWithOnMemoryCsvTest, MultiByteFieldTerminatorColumnMismatch) {
+  const char * const csv =
+    "1~|~2\n"
+    "1~|2\n";
+
+  Memory::CsvConfig csv_config(csv, false);
+  csv_config.set_field_terminator("~|~");
+  EXPECT_EQ(2, csv_config.get_n_columns());
+
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_THROW(parser.get_row(row), PCPCsvError);
+
+  std::vector<size_t> invalid_line_offsets;
+  PartialCsvParser validator(csv_config);
+  EXPECT_EQ(2, validator.validate(invalid_line_offsets));
+  ASSERT_EQ(1, invalid_line_offsets.size());
+  EXPECT_EQ(6, invalid_line_offsets[0]);
+}
+
+TEST_F(PartialCsvParserWithOnMemoryCsvTest, TrimWhitespaces) {
+  const char * const csv =
+    " id , name \n"
+    "  123 , foo  \n"
+    "4,\t\tbar\n";
+
+  Memory::CsvConfig csv_config(csv);
+  csv_config.set_trim_whitespaces(true);
+  ASSERT_EQ(2, csv_config.get_headers().size());
+  EXPECT_EQ("id", csv_config.get_headers()[0]);
+  EXPECT_EQ("name", csv_config.get_headers()[1]);
+
+  PartialCsvParser parser(csv_config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("123", row[0]);
+  EXPECT_EQ("foo", row[1]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("4", row[0]);
+  EXPECT_EQ("bar", row[1]);
+  EXPECT_FALSE(parser.get_row(row));
+}
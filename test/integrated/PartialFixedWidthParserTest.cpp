@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class PartialFixedWidthParserTest : public ::testing::Test {
+protected:
+  PartialFixedWidthParserTest() {}
+
+  virtual void SetUp() {
+    widths.push_back(3);
+    widths.push_back(5);
+    widths.push_back(2);
+  }
+
+  // parse with parsers of ranges split at every offset, and return all rows
+  static std::vector<std::vector<std::string> > parse_in_two_ranges(const Memory::FixedWidthConfig & config, size_t split) {
+    std::vector<std::vector<std::string> > rows;
+    std::vector<std::string> row;
+    PartialFixedWidthParser parser1(config, 0, split - 1);
+    while (parser1.get_row(row)) rows.push_back(row);
+    PartialFixedWidthParser parser2(config, split);
+    while (parser2.get_row(row)) rows.push_back(row);
+    return rows;
+  }
+
+  std::vector<size_t> widths;
+};
+
+TEST_F(PartialFixedWidthParserTest, ConstantLineLength) {
+  const std::string text =
+    "001Alice42\n"
+    "002Bob  07\n"
+    "003Carol99\n";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths);
+  EXPECT_EQ(3, config.get_n_columns());
+  EXPECT_EQ(10, config.get_record_width());
+  EXPECT_EQ(11, config.get_record_length());
+  EXPECT_EQ(3, config.get_n_records());
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("001", row[0]);
+  EXPECT_EQ("Alice", row[1]);
+  EXPECT_EQ("42", row[2]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("Bob  ", row[1]);
+  ASSERT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("003", row[0]);
+  EXPECT_TRUE(parser.get_row().empty());
+}
+
+TEST_F(PartialFixedWidthParserTest, NoLineTerminator) {
+  const std::string text = "001Alice42002Bob  07003Carol99";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths, Memory::FixedWidthConfig::NO_LINE_TERMINATOR);
+  EXPECT_EQ(10, config.get_record_length());
+  EXPECT_EQ(3, config.get_n_records());
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  std::vector<std::string> names;
+  while (parser.get_row(row)) {
+    EXPECT_EQ(3, row.size());
+    names.push_back(row[1]);
+  }
+  ASSERT_EQ(3, names.size());
+  EXPECT_EQ("Alice", names[0]);
+  EXPECT_EQ("Carol", names[2]);
+}
+
+TEST_F(PartialFixedWidthParserTest, VariableLineLength) {
+  // trailing padding is dropped by some exporters
+  const std::string text =
+    "001Alice42\n"
+    "002Bob\n"
+    "\n"
+    "003Carol99";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths, '\n', false);
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("42", row[2]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("Bob", row[1]);
+  EXPECT_EQ("", row[2]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ(3, row.size());
+  EXPECT_EQ("", row[0]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("99", row[2]);
+  EXPECT_FALSE(parser.get_row(row));
+}
+
+TEST_F(PartialFixedWidthParserTest, RangesParseEachRecordExactlyOnce) {
+  const std::string text =
+    "001Alice42\n"
+    "002Bob  07\n"
+    "003Carol99\n"
+    "004Dave 11\n";
+  const std::string variable_text =
+    "001Alice42\n"
+    "002Bob\n"
+    "003Carol99\n"
+    "004Dave\n";
+  Memory::FixedWidthConfig constant_config(text.size(), text.data(), widths);
+  Memory::FixedWidthConfig variable_config(variable_text.size(), variable_text.data(), widths, '\n', false);
+  const std::string text_without_terminator = "001Alice42002Bob  07003Carol99004Dave 11";
+  Memory::FixedWidthConfig no_terminator_config(text_without_terminator.size(), text_without_terminator.data(), widths, Memory::FixedWidthConfig::NO_LINE_TERMINATOR);
+
+  const Memory::FixedWidthConfig * configs[] = {&constant_config, &variable_config, &no_terminator_config};
+  for (size_t i_config = 0; i_config < 3; ++i_config) {
+    for (size_t split = 1; split < configs[i_config]->filesize(); ++split) {
+      std::vector<std::vector<std::string> > rows = parse_in_two_ranges(*configs[i_config], split);
+      ASSERT_EQ(4, rows.size()) << i_config << ", " << split;
+      for (size_t i = 0; i < rows.size(); ++i) EXPECT_EQ("00" + std::to_string(i + 1), rows[i][0]) << i_config << ", " << split;
+    }
+  }
+}
+
+TEST_F(PartialFixedWidthParserTest, TruncatedLastRecord) {
+  const std::string text = "001Alice42002Bo";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths, Memory::FixedWidthConfig::NO_LINE_TERMINATOR);
+  EXPECT_EQ(2, config.get_n_records());
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("002", row[0]);
+  EXPECT_EQ("Bo", row[1]);
+  EXPECT_EQ("", row[2]);
+  EXPECT_FALSE(parser.get_row(row));
+}
+
+TEST_F(PartialFixedWidthParserTest, TrimWhitespaces) {
+  const std::string text =
+    "  1Bob   7\n"
+    " 22 Eve 99\n";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths);
+  config.set_trim_whitespaces(true);
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("1", row[0]);
+  EXPECT_EQ("Bob", row[1]);
+  EXPECT_EQ("7", row[2]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("22", row[0]);
+  EXPECT_EQ("Eve", row[1]);
+  EXPECT_EQ("99", row[2]);
+}
+
+TEST_F(PartialFixedWidthParserTest, BlankLineAtEnd) {
+  const std::string text =
+    "001Alice42\n"
+    "002Bob  07\n"
+    "\n";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths);
+  EXPECT_EQ(2, config.get_n_records());
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("001", row[0]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("002", row[0]);
+  EXPECT_FALSE(parser.get_row(row));
+
+  for (size_t split = 1; split < text.size(); ++split) EXPECT_EQ(2, parse_in_two_ranges(config, split).size()) << split;
+}
+
+TEST_F(PartialFixedWidthParserTest, MalformedRecord) {
+  const std::string text =
+    "001Alice42\n"
+    "002Bob07\n"  // short line
+    "003Carol99\n"
+    "004Dave 11\n";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths);
+
+  PartialFixedWidthParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  try {
+    parser.get_row(row);
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(2, e.get_line_number());
+  }
+
+  // a range starting after the malformed record finds shifted records
+  PartialFixedWidthParser parser2(config, 22);
+  EXPECT_THROW(parser2.get_row(row), PCPCsvError);
+
+  // the last record is truncated by a line terminator
+  const std::string truncated_text = "001Alice42\n002Bo\n";
+  Memory::FixedWidthConfig truncated_config(truncated_text.size(), truncated_text.data(), widths);
+  PartialFixedWidthParser truncated_parser(truncated_config);
+  ASSERT_TRUE(truncated_parser.get_row(row));
+  EXPECT_THROW(truncated_parser.get_row(row), PCPCsvError);
+}
+
+TEST_F(PartialFixedWidthParserTest, ParseInParallel) {
+  std::string text;
+  for (int i = 0; i < 1000; ++i) text += "001Alice42\n";
+  Memory::FixedWidthConfig config(text.size(), text.data(), widths);
+
+  std::atomic<size_t> n_rows(0);
+  parse_in_parallel<PartialFixedWidthParser>(config, 4, 100, [&](const std::vector<std::string> & row) {
+    EXPECT_EQ("Alice", row[1]);
+    ++n_rows;
+  });
+  EXPECT_EQ(1000, n_rows.load());
+}
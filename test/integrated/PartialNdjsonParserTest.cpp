@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class PartialNdjsonParserTest : public ::testing::Test {
+protected:
+  PartialNdjsonParserTest() {}
+
+  virtual void SetUp() {
+    keys.push_back("id");
+    keys.push_back("name");
+    keys.push_back("score");
+  }
+
+  std::vector<std::string> keys;
+};
+
+TEST_F(PartialNdjsonParserTest, ExtractKeys) {
+  const std::string text =
+    "{\"id\":1,\"name\":\"Alice\",\"score\":4.5}\n"
+    "{ \"score\" : null , \"extra\" : {\"name\":\"nested\",\"list\":[1,2,\"]\"]}, \"name\" : \"Bob\", \"id\" : 2 }\n"
+    "{\"id\":3,\"tags\":[\"a\",\"b\"]}\n";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+  EXPECT_EQ(3, config.get_n_columns());
+
+  PartialNdjsonParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  ASSERT_EQ(3, row.size());
+  EXPECT_EQ("1", row[0]);
+  EXPECT_EQ("Alice", row[1]);
+  EXPECT_EQ("4.5", row[2]);
+
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("2", row[0]);
+  EXPECT_EQ("Bob", row[1]);
+  EXPECT_EQ("null", row[2]);
+
+  // missing keys are empty
+  ASSERT_FALSE((row = parser.get_row()).empty());
+  EXPECT_EQ("3", row[0]);
+  EXPECT_EQ("", row[1]);
+  EXPECT_EQ("", row[2]);
+
+  EXPECT_FALSE(parser.get_row(row));
+  EXPECT_TRUE(row.empty());
+}
+
+TEST_F(PartialNdjsonParserTest, NestedValuesAreRawText) {
+  std::vector<std::string> nested_keys;
+  nested_keys.push_back("obj");
+  nested_keys.push_back("arr");
+  const std::string text = "{\"arr\":[1, {\"x\":\"}\"}],\"obj\":{\"a\":{\"b\":true}}}";
+  Memory::NdjsonConfig config(text.size(), text.data(), nested_keys);
+
+  PartialNdjsonParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("{\"a\":{\"b\":true}}", row[0]);
+  EXPECT_EQ("[1, {\"x\":\"}\"}]", row[1]);
+}
+
+TEST_F(PartialNdjsonParserTest, EscapeSequences) {
+  const std::string text =
+    "{\"name\":\"tab\\there \\\"quoted\\\" back\\\\slash\\/\",\"id\":\"\\u3042\\u00e9\\ud83d\\ude00\"}\r\n";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+
+  PartialNdjsonParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("\xe3\x81\x82\xc3\xa9\xf0\x9f\x98\x80", row[0]);
+  EXPECT_EQ("tab\there \"quoted\" back\\slash/", row[1]);
+  EXPECT_FALSE(parser.get_row(row));
+}
+
+TEST_F(PartialNdjsonParserTest, BlankLinesAreSkipped) {
+  const std::string text = "\n{\"id\":1}\n  \n{\"id\":2}";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+
+  PartialNdjsonParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("1", row[0]);
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("2", row[0]);
+  EXPECT_FALSE(parser.get_row(row));
+}
+
+TEST_F(PartialNdjsonParserTest, InvalidLine) {
+  const std::string text = "{\"id\":1}\n[1,2]\n";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+
+  PartialNdjsonParser parser(config);
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  try {
+    parser.get_row(row);
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(2, e.get_line_number());
+  }
+
+  const char * const invalid_lines[] = {"{\"id\":1", "{\"id\" 1}", "{\"id\":1,}", "{\"id\":\"\\x\"}", "{id:1}"};
+  for (size_t i = 0; i < sizeof(invalid_lines) / sizeof(invalid_lines[0]); ++i) {
+    Memory::NdjsonConfig invalid_config(std::strlen(invalid_lines[i]), invalid_lines[i], keys);
+    PartialNdjsonParser invalid_parser(invalid_config);
+    EXPECT_THROW(invalid_parser.get_row(row), PCPCsvError) << invalid_lines[i];
+  }
+}
+
+TEST_F(PartialNdjsonParserTest, InvalidLineNumberIsCountedFromFileBeginning) {
+  const std::string text = "{\"id\":1}\n{\"id\":2}\n\n{\"id\":3}\n[1,2]\n";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+
+  PartialNdjsonParser parser(config, text.find("{\"id\":3}"));
+  std::vector<std::string> row;
+  ASSERT_TRUE(parser.get_row(row));
+  EXPECT_EQ("3", row[0]);
+  try {
+    parser.get_row(row);
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(5, e.get_line_number());
+  }
+}
+
+TEST_F(PartialNdjsonParserTest, RangesParseEachLineExactlyOnce) {
+  const std::string text =
+    "{\"id\":1,\"name\":\"a\"}\n"
+    "{\"id\":2,\"name\":\"bb\\nbb\"}\n"
+    "\n"
+    "{\"name\":\"c\",\"id\":3}\n"
+    "{\"id\":4}";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+
+  for (size_t split1 = 1; split1 < text.size(); ++split1) {
+    for (size_t split2 = split1 + 1; split2 < text.size(); ++split2) {
+      std::vector<std::string> ids;
+      std::vector<std::string> row;
+      PartialNdjsonParser parser1(config, 0, split1 - 1);
+      while (parser1.get_row(row)) ids.push_back(row[0]);
+      PartialNdjsonParser parser2(config, split1, split2 - 1);
+      while (parser2.get_row(row)) ids.push_back(row[0]);
+      PartialNdjsonParser parser3(config, split2);
+      while (parser3.get_row(row)) ids.push_back(row[0]);
+
+      ASSERT_EQ(4, ids.size()) << split1 << ", " << split2;
+      for (size_t i = 0; i < ids.size(); ++i) EXPECT_EQ(std::to_string(i + 1), ids[i]) << split1 << ", " << split2;
+    }
+  }
+}
+
+TEST_F(PartialNdjsonParserTest, ParseInParallel) {
+  std::string text;
+  for (int i = 1; i <= 1000; ++i) text += "{\"name\":\"x\",\"id\":" + std::to_string(i) + "}\n";
+  Memory::NdjsonConfig config(text.size(), text.data(), keys);
+
+  std::atomic<size_t> n_rows(0), id_sum(0);
+  parse_in_parallel<PartialNdjsonParser>(config, 4, 100, [&](const std::vector<std::string> & row) {
+    ++n_rows;
+    id_sum += std::stoul(row[0]);
+  });
+  EXPECT_EQ(1000, n_rows.load());
+  EXPECT_EQ(1000 * 1001 / 2, id_sum.load());
+
+  // the error of the earliest chunk is rethrown
+  text += "[1]\n";
+  Memory::NdjsonConfig invalid_config(text.size(), text.data(), keys);
+  try {
+    parse_in_parallel<PartialNdjsonParser>(invalid_config, 4, 100, [](const std::vector<std::string> &) {});
+    FAIL();
+  }
+  catch (const PCPCsvError & e) {
+    EXPECT_EQ(1001, e.get_line_number());
+  }
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class PipelineTest : public ::testing::TestWithParam<std::tuple<size_t, size_t> > {
+protected:
+  PipelineTest() {}
+
+  virtual void SetUp() {
+    n_threads = std::get<0>(GetParam());
+    n_stage_threads = std::get<1>(GetParam());
+    std::ostringstream ss;
+    for (size_t i = 0; i < n_rows; ++i) ss << i << ",abcdefghij\n";
+    csv = ss.str();
+  }
+
+  static const size_t n_rows = 20000;
+  size_t n_threads, n_stage_threads;
+  std::string csv;
+};
+
+TEST_P(PipelineTest, AllRowsReachSinkExactlyOnce) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, n_threads, 4096);
+  Pipeline pipeline(parser, 100);
+
+  std::vector<std::atomic<int> > seen(n_rows);
+  for (size_t i = 0; i < n_rows; ++i) seen[i] = 0;
+  pipeline
+    .add_stage([](Pipeline::batch_t & batch) {
+      // keep even ids, and append a column
+      Pipeline::batch_t even;
+      for (size_t i = 0; i < batch.size(); ++i) {
+        if (std::atoi(batch[i][0].c_str()) % 2 != 0) continue;
+        even.push_back(batch[i]);
+        even.back().push_back("even");
+      }
+      batch.swap(even);
+    }, n_stage_threads)
+    .run([&](Pipeline::batch_t & batch) {
+      for (size_t i = 0; i < batch.size(); ++i) {
+        ASSERT_EQ(3, batch[i].size());
+        ++seen[std::atoi(batch[i][0].c_str())];
+      }
+    }, n_stage_threads);
+
+  for (size_t i = 0; i < n_rows; ++i) ASSERT_EQ(i % 2 == 0 ? 1 : 0, seen[i]) << i;
+}
+
+TEST_P(PipelineTest, SlowSinkHoldsBackParser) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, n_threads, 4096);
+  const size_t batch_size = 100;
+  Pipeline pipeline(parser, batch_size, 2);
+  pipeline.add_stage([](Pipeline::batch_t &) {}, n_stage_threads);
+
+  // rows parsed but not yet sunk are in batches, which are never more than get_n_batches()
+  const size_t max_rows_in_flight = pipeline.get_n_batches(n_stage_threads) * batch_size;
+  std::atomic<size_t> n_sunk(0), max_lag(0);
+  pipeline.run([&](Pipeline::batch_t & batch) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    const size_t lag = parser.get_progress().rows - n_sunk;
+    for (size_t m = max_lag; lag > m && !max_lag.compare_exchange_weak(m, lag); ) ;
+    n_sunk += batch.size();
+  }, n_stage_threads);
+
+  EXPECT_EQ(size_t(n_rows), n_sunk);
+  EXPECT_LE(max_lag, max_rows_in_flight);
+}
+
+TEST_P(PipelineTest, ExceptionInStageStopsPipeline) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, n_threads, 4096);
+  Pipeline pipeline(parser, 100);
+  pipeline.add_stage([](Pipeline::batch_t & batch) {
+    for (size_t i = 0; i < batch.size(); ++i)
+      if (batch[i][0] == "12345") throw std::runtime_error("bad row");
+  }, n_stage_threads);
+  EXPECT_THROW(pipeline.run([](Pipeline::batch_t &) {}, n_stage_threads), std::runtime_error);
+}
+
+TEST_P(PipelineTest, ParseErrorStopsPipeline) {
+  std::string invalid_csv = csv + "1,2,3\n" + csv;
+  Memory::CsvConfig csv_config(invalid_csv.size(), invalid_csv.data(), false);
+  ParallelCsvParser parser(csv_config, n_threads, 4096);
+  Pipeline pipeline(parser, 100);
+  EXPECT_THROW(pipeline.run([](Pipeline::batch_t &) {}, n_stage_threads), PCPCsvError);
+}
+
+INSTANTIATE_TEST_CASE_P(_, PipelineTest, ::testing::Combine(
+  ::testing::Values(1UL, 4UL),
+  ::testing::Values(1UL, 3UL)
+));
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+class ResourceGovernorTest : public ::testing::Test {
+protected:
+  ResourceGovernorTest() {}
+
+  virtual void SetUp() {
+    // about 1 MB
+    std::ostringstream ss;
+    for (size_t i = 0; i < n_rows; ++i) ss << i << ",abcdefghijklmnopqrstuvwxyz0123456789\n";
+    csv = ss.str();
+  }
+
+  static double elapsed_sec(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  static const size_t n_rows = 25000;
+  std::string csv;
+};
+
+TEST_F(ResourceGovernorTest, Unlimited) {
+  ResourceGovernor governor;
+  EXPECT_EQ(size_t(ResourceGovernor::UNLIMITED), governor.get_max_workers());
+  EXPECT_EQ(size_t(ResourceGovernor::UNLIMITED), governor.get_bytes_per_sec());
+  EXPECT_FALSE(governor.is_paused());
+
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, 4, 16 * 1024);
+  parser.set_resource_governor(&governor);
+  std::atomic<size_t> n_parsed(0);
+  parser.parse([&](const std::vector<std::string> &, size_t) { ++n_parsed; });
+  EXPECT_EQ(size_t(n_rows), n_parsed);
+}
+
+TEST_F(ResourceGovernorTest, BytesPerSec) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, 4, 16 * 1024);
+  ResourceGovernor governor;
+  governor.set_bytes_per_sec(csv.size() * 4);  // 0.25 sec for whole CSV
+  parser.set_resource_governor(&governor);
+
+  std::atomic<size_t> n_parsed(0);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  parser.parse([&](const std::vector<std::string> &, size_t) { ++n_parsed; });
+  EXPECT_EQ(size_t(n_rows), n_parsed);
+  // the last chunk starts after all other chunks are paid for
+  EXPECT_GE(elapsed_sec(start), 0.25 * (csv.size() - 16 * 1024) / csv.size());
+}
+
+TEST_F(ResourceGovernorTest, BudgetIsSharedByParsers) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ResourceGovernor governor;
+  governor.set_bytes_per_sec(csv.size() * 8);  // 0.125 sec for each parser
+
+  std::atomic<size_t> n_parsed(0);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> jobs;
+  for (int i = 0; i < 2; ++i) {
+    jobs.push_back(std::thread([&]() {
+      ParallelCsvParser parser(csv_config, 2, 16 * 1024);
+      parser.set_resource_governor(&governor);
+      parser.parse([&](const std::vector<std::string> &, size_t) { ++n_parsed; });
+    }));
+  }
+  for (size_t i = 0; i < jobs.size(); ++i) jobs[i].join();
+  EXPECT_EQ(size_t(n_rows * 2), n_parsed);
+  EXPECT_GE(elapsed_sec(start), 0.25 * (csv.size() - 16 * 1024) / csv.size());
+}
+
+TEST_F(ResourceGovernorTest, MaxWorkers) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, 4, 16 * 1024);
+  ResourceGovernor governor;
+  governor.set_max_workers(1);
+  parser.set_resource_governor(&governor);
+
+  // synthetic contention: visitor is slow enough for workers to overlap if allowed
+  std::atomic<int> n_running(0), max_running(0);
+  std::atomic<size_t> n_parsed(0);
+  parser.parse([&](const std::vector<std::string> &, size_t) {
+    const int n = ++n_running;
+    for (int m = max_running; n > m && !max_running.compare_exchange_weak(m, n); ) ;
+    if (++n_parsed % 1000 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    --n_running;
+  });
+  EXPECT_EQ(size_t(n_rows), n_parsed);
+  EXPECT_EQ(1, max_running);
+  EXPECT_EQ(0u, parser.get_progress().workers[1].bytes_consumed);
+}
+
+TEST_F(ResourceGovernorTest, PauseAndResume) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, 2, 16 * 1024);
+  ResourceGovernor governor;
+  governor.pause();
+  EXPECT_TRUE(governor.is_paused());
+  parser.set_resource_governor(&governor);
+
+  std::atomic<size_t> n_parsed(0);
+  std::thread job([&]() {
+    parser.parse([&](const std::vector<std::string> &, size_t) { ++n_parsed; });
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(0u, n_parsed);
+
+  governor.resume();
+  job.join();
+  EXPECT_EQ(size_t(n_rows), n_parsed);
+}
+
+TEST_F(ResourceGovernorTest, CancelWhilePaused) {
+  Memory::CsvConfig csv_config(csv.size(), csv.data(), false);
+  ParallelCsvParser parser(csv_config, 2, 16 * 1024);
+  ResourceGovernor governor;
+  governor.pause();
+  parser.set_resource_governor(&governor);
+  CancellationToken token;
+  token.set_timeout(std::chrono::milliseconds(50));
+  parser.set_cancellation_token(&token);
+
+  EXPECT_THROW(parser.parse([](const std::vector<std::string> &, size_t) {}), PCPCancelledError);
+}
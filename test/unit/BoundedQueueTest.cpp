@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+TEST(BoundedQueueTest, CapacityIsRoundedUpToPowerOf2) {
+  EXPECT_EQ(2, BoundedQueue<int>(1).get_capacity());
+  EXPECT_EQ(4, BoundedQueue<int>(3).get_capacity());
+  EXPECT_EQ(8, BoundedQueue<int>(8).get_capacity());
+}
+
+TEST(BoundedQueueTest, FifoAndBounded) {
+  BoundedQueue<int> queue(4);
+  int value;
+  EXPECT_FALSE(queue.try_pop(value));
+  for (int i = 0; i < 4; ++i) EXPECT_TRUE(queue.try_push(i));
+  EXPECT_FALSE(queue.try_push(4));
+
+  // wrap around
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(queue.try_pop(value));
+      EXPECT_EQ(round * 4 + i, value);
+      EXPECT_TRUE(queue.try_push((round + 1) * 4 + i));
+    }
+  }
+}
+
+TEST(BoundedQueueTest, Close) {
+  BoundedQueue<int> queue(4);
+  queue.push(1);
+  queue.push(2);
+  queue.close();
+  EXPECT_TRUE(queue.is_closed());
+  EXPECT_FALSE(queue.push(3));
+
+  int value;
+  EXPECT_TRUE(queue.pop(value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(queue.pop(value));
+  EXPECT_EQ(2, value);
+  EXPECT_FALSE(queue.pop(value));
+}
+
+TEST(BoundedQueueTest, MultipleProducersAndConsumers) {
+  BoundedQueue<size_t> queue(16);
+  const size_t n_producers = 4, n_consumers = 4, n_values = 100000;
+  std::atomic<size_t> sum(0), n_popped(0);
+
+  std::vector<std::thread> producers, consumers;
+  for (size_t i = 0; i < n_consumers; ++i) {
+    consumers.push_back(std::thread([&]() {
+      size_t value;
+      while (queue.pop(value)) {
+        sum += value;
+        ++n_popped;
+      }
+    }));
+  }
+  for (size_t i = 0; i < n_producers; ++i) {
+    producers.push_back(std::thread([&, i]() {
+      for (size_t value = i; value < n_values; value += n_producers) ASSERT_TRUE(queue.push(value));
+    }));
+  }
+  for (size_t i = 0; i < producers.size(); ++i) producers[i].join();
+  queue.close();
+  for (size_t i = 0; i < consumers.size(); ++i) consumers[i].join();
+
+  EXPECT_EQ(n_values, n_popped);
+  EXPECT_EQ(n_values * (n_values - 1) / 2, sum);
+}
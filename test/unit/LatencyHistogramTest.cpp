@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <PartialCsvParser.hpp>
+
+using namespace PCP;
+
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.get_count());
+  EXPECT_EQ(0, histogram.get_percentile(50));
+  EXPECT_EQ(0, histogram.get_mean());
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  LatencyHistogram histogram;
+  for (uint64_t ns = 1; ns <= 100; ++ns) histogram.record(ns);
+  EXPECT_EQ(100, histogram.get_count());
+  EXPECT_EQ(1, histogram.get_min());
+  EXPECT_EQ(100, histogram.get_max());
+  EXPECT_DOUBLE_EQ(50.5, histogram.get_mean());
+  EXPECT_EQ(50, histogram.get_percentile(50));
+  EXPECT_EQ(99, histogram.get_percentile(99));
+  EXPECT_EQ(100, histogram.get_percentile(100));
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinPrecision) {
+  LatencyHistogram histogram;
+  for (uint64_t ns = 1; ns <= 1000000; ++ns) histogram.record(ns * 1000);  // 1 us ~ 1 s
+
+  const double percentiles[] = { 50, 90, 99, 99.9 };
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+    const double exact = percentiles[i] / 100 * 1000000 * 1000;
+    const uint64_t value = histogram.get_percentile(percentiles[i]);
+    EXPECT_GE(value, exact - 1000) << percentiles[i];
+    EXPECT_LE(value, exact * (1 + 1.0 / LatencyHistogram::SUB_BUCKET_COUNT)) << percentiles[i];
+  }
+  EXPECT_EQ(1000000000, histogram.get_max());
+}
+
+TEST(LatencyHistogramTest, TailIsVisible) {
+  LatencyHistogram histogram;
+  for (size_t i = 0; i < 9990; ++i) histogram.record(std::chrono::microseconds(10));
+  for (size_t i = 0; i < 10; ++i) histogram.record(std::chrono::milliseconds(50));
+  EXPECT_LE(histogram.get_percentile(99), 10000 * (1 + 1.0 / LatencyHistogram::SUB_BUCKET_COUNT));
+  EXPECT_GE(histogram.get_percentile(99.95), 50000000);
+}
+
+TEST(LatencyHistogramTest, HugeValuesAreClamped) {
+  LatencyHistogram histogram;
+  histogram.record(uint64_t(-1));
+  EXPECT_EQ((uint64_t(1) << LatencyHistogram::MAX_VALUE_BITS) - 1, histogram.get_max());
+  EXPECT_EQ(histogram.get_max(), histogram.get_percentile(100));
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  LatencyHistogram a, b;
+  for (uint64_t ns = 1; ns <= 50; ++ns) a.record(ns);
+  for (uint64_t ns = 51; ns <= 100; ++ns) b.record(ns);
+  a.merge(b);
+  EXPECT_EQ(100, a.get_count());
+  EXPECT_EQ(1, a.get_min());
+  EXPECT_EQ(100, a.get_max());
+  EXPECT_EQ(90, a.get_percentile(90));
+
+  a.clear();
+  EXPECT_EQ(0, a.get_count());
+  EXPECT_EQ(0, a.get_max());
+}
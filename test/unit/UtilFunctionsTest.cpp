@@ -82,3 +82,157 @@ INSTANTIATE_TEST_CASE_P(_, _split_Test, ::testing::Values(
   std::make_tuple(",bbb,,", STR_ARRAY("", "bbb", "", "")),
   std::make_tuple("", STR_ARRAY(""))
 ));
+
+
+class _find_pattern_Test :
+  public ::testing::TestWithParam<std::tuple<const char *, const char *, int> >
+{};
+
+TEST_P(_find_pattern_Test, find_first_occurrence)
+{
+  const char * const text = std::get<0>(GetParam());
+  const char * const pattern = std::get<1>(GetParam());
+  int expected_offset = std::get<2>(GetParam());
+
+  const char * found = _find_pattern(text, std::strlen(text), pattern, std::strlen(pattern));
+  if (expected_offset < 0) EXPECT_EQ(NULL, found);
+  else EXPECT_EQ(text + expected_offset, found);
+}
+
+INSTANTIATE_TEST_CASE_P(_, _find_pattern_Test, ::testing::Values(
+  std::make_tuple("aa,bbb,c", "a", 0),
+  std::make_tuple("aa,bbb,c", "bbb", 3),
+  std::make_tuple("aa,bbb,c", "b,c", 5),
+  std::make_tuple("aa,bbb,c", ",c", 6),
+  std::make_tuple("aa,bbb,c", "c,", -1),
+  std::make_tuple("abababc", "abc", 4),
+  std::make_tuple("ab", "abc", -1),
+  std::make_tuple("", "a", -1)
+));
+
+
+class _count_char_Test :
+  public ::testing::TestWithParam<std::tuple<const char *, size_t> >
+{};
+
+TEST_P(_count_char_Test, count_correctly)
+{
+  const char * const text = std::get<0>(GetParam());
+  size_t expected_count = std::get<1>(GetParam());
+  EXPECT_EQ(expected_count, _count_char(text, std::strlen(text), ','));
+}
+
+INSTANTIATE_TEST_CASE_P(_, _count_char_Test, ::testing::Values(
+  std::make_tuple("", 0UL),
+  std::make_tuple("aa,bbb,c", 2UL),
+  std::make_tuple(",,,,,,,,", 8UL),
+  std::make_tuple(",,,,,,,,,,,,,,,,,", 17UL),
+  std::make_tuple("a,b,c,d,e,f,g,h,i,j,k,l,m,n", 13UL),
+  std::make_tuple("\xac\xad\x2d\x6c,", 1UL),  // bytes near ',' (0x2c)
+  std::make_tuple("寿限無、寿限無,五劫の擦り切れ", 1UL)
+));
+
+
+class _skip_json_value_Test :
+  public ::testing::TestWithParam<std::tuple<const char *, int> >
+{};
+
+TEST_P(_skip_json_value_Test, skip_to_end_of_value)
+{
+  const char * const text = std::get<0>(GetParam());
+  int expected_length = std::get<1>(GetParam());
+
+  const char * end = _skip_json_value(text, text + std::strlen(text));
+  if (expected_length < 0) EXPECT_EQ(NULL, end);
+  else EXPECT_EQ(text + expected_length, end);
+}
+
+INSTANTIATE_TEST_CASE_P(_, _skip_json_value_Test, ::testing::Values(
+  std::make_tuple("123,", 3),
+  std::make_tuple("true}", 4),
+  std::make_tuple("\"abc\",", 5),
+  std::make_tuple("\"a long string over 8 bytes \\\" with escaped quote\" ", 50),
+  std::make_tuple("\"a\\\\\"x", 5),
+  std::make_tuple("{\"a\":[1,{\"b\":\"}]\"}],\"c\":{}} ,", 27),
+  std::make_tuple("[[[[[[[[[[]]]]]]]]]]]", 20),
+  std::make_tuple("{\"a\":1", -1),
+  std::make_tuple("\"abc", -1),
+  std::make_tuple(",", -1)
+));
+
+
+class _split_multi_byte_Test :
+  public ::testing::TestWithParam<std::tuple<const char *, const char *, std::vector<std::string> > >
+{};
+
+TEST_P(_split_multi_byte_Test, get_correct_split_strings)
+{
+  const char * const str = std::get<0>(GetParam());
+  const std::string delimiter = std::get<1>(GetParam());
+  std::vector<std::string> expected_split_strings = std::get<2>(GetParam());
+
+  std::vector<std::string> split_strings;
+  _split(str, std::strlen(str), delimiter, split_strings);
+  ASSERT_EQ(expected_split_strings, split_strings);
+  EXPECT_EQ(expected_split_strings.size() - 1, _count_delimiter(str, std::strlen(str), delimiter));
+}
+
+INSTANTIATE_TEST_CASE_P(_, _split_multi_byte_Test, ::testing::Values(
+  std::make_tuple("aa||bbb||c", "||", STR_ARRAY("aa", "bbb", "c")),
+  std::make_tuple("a|b,c||d", "||", STR_ARRAY("a|b,c", "d")),
+  std::make_tuple("||bbb||||", "||", STR_ARRAY("", "bbb", "", "")),
+  std::make_tuple("a|||b", "||", STR_ARRAY("a", "|b")),
+  std::make_tuple("a~|~|~b", "~|~", STR_ARRAY("a", "|~b")),
+  std::make_tuple("a long column over 8 bytes~|~another long column~|~", "~|~", STR_ARRAY("a long column over 8 bytes", "another long column", "")),
+  std::make_tuple("no delimiter here~|", "~|~", STR_ARRAY("no delimiter here~|")),
+  std::make_tuple("aa,bbb,c", ",", STR_ARRAY("aa", "bbb", "c")),
+  std::make_tuple("", "||", STR_ARRAY(""))
+));
+
+
+class _trim_whitespaces_Test :
+  public ::testing::TestWithParam<std::tuple<const char *, const char *> >
+{};
+
+TEST_P(_trim_whitespaces_Test, exclude_padding)
+{
+  const char * const str = std::get<0>(GetParam());
+  const char * const expected_str = std::get<1>(GetParam());
+
+  const char * begin = str, * end = str + std::strlen(str);
+  _trim_whitespaces(&begin, &end);
+  EXPECT_EQ(expected_str, std::string(begin, end));
+}
+
+INSTANTIATE_TEST_CASE_P(_, _trim_whitespaces_Test, ::testing::Values(
+  std::make_tuple("", ""),
+  std::make_tuple("   ", ""),
+  std::make_tuple("                         ", ""),
+  std::make_tuple("abc", "abc"),
+  std::make_tuple("  123 ", "123"),
+  std::make_tuple("\t foo bar\t ", "foo bar"),
+  std::make_tuple("                    long padding                    ", "long padding"),
+  std::make_tuple("        x        ", "x"),
+  std::make_tuple("a                                b", "a                                b")
+));
+
+
+TEST(_split_trim_whitespaces_Test, trim_each_column)
+{
+  const char * const str = "  123 , foo  ,,   ,\tbar baz\t";
+  std::vector<std::string> columns;
+  _split(str, std::strlen(str), ',', columns, true);
+  ASSERT_EQ(5, columns.size());
+  EXPECT_EQ("123", columns[0]);
+  EXPECT_EQ("foo", columns[1]);
+  EXPECT_EQ("", columns[2]);
+  EXPECT_EQ("", columns[3]);
+  EXPECT_EQ("bar baz", columns[4]);
+
+  const char * const multi_byte_str = " a || b ||c";
+  _split(multi_byte_str, std::strlen(multi_byte_str), std::string("||"), columns, true);
+  ASSERT_EQ(3, columns.size());
+  EXPECT_EQ("a", columns[0]);
+  EXPECT_EQ("b", columns[1]);
+  EXPECT_EQ("c", columns[2]);
+}